@@ -0,0 +1,56 @@
+#!/bin/bash
+
+# Measures the CPU billed for sending tokens to N recipients with N transfer actions and with one transfers action.
+# Run against a local node where FROM holds enough tokens and every recipient account exists, e.g.
+#   ./bench-transfers.sh eosio.token gov.tmy "0.000001 TONO" 5 ops.tmy team.tmy partners.tmy
+#
+# Arguments: contract, from, quantity sent to each recipient, number of rounds, recipients
+#
+# Each round pushes one transaction with a transfer action per recipient, then one transaction with a single
+# transfers action to all recipients, and prints the cpu_usage_us of each receipt.
+
+set -u ## exit if you try to use an uninitialised variable
+set -e ## exit if any statement fails
+
+CONTRACT=$1
+FROM=$2
+QUANTITY=$3
+ROUNDS=$4
+shift 4
+RECIPIENTS=("$@")
+N=${#RECIPIENTS[@]}
+
+if [ "$N" -eq 0 ]; then
+    echo "Usage: $0 <contract> <from> <quantity> <rounds> <recipient>..."
+    exit 1
+fi
+
+function cpu_usage {
+    # The receipt of the transaction is the first cpu_usage_us in the output
+    grep -o '"cpu_usage_us": [0-9]*' | head -n 1 | grep -o '[0-9]*$'
+}
+
+function push {
+    cleos push transaction --json "$1" -p "${FROM}@active" | cpu_usage
+}
+
+echo "rounds: ${ROUNDS}, recipients: ${N}"
+echo "round, ${N} x transfer (us), transfers (us), transfer per recipient (us), transfers per recipient (us)"
+
+for ((round = 0; round < ROUNDS; round++)); do
+    # The memo makes every transaction unique
+    memo="bench ${round} $(date +%s%N)"
+
+    actions=""
+    entries=""
+    for to in "${RECIPIENTS[@]}"; do
+        actions+="{\"account\":\"${CONTRACT}\",\"name\":\"transfer\",\"authorization\":[{\"actor\":\"${FROM}\",\"permission\":\"active\"}],"
+        actions+="\"data\":{\"from\":\"${FROM}\",\"to\":\"${to}\",\"quantity\":\"${QUANTITY}\",\"memo\":\"${memo}\"}},"
+        entries+="{\"to\":\"${to}\",\"quantity\":\"${QUANTITY}\",\"memo\":\"${memo}\"},"
+    done
+
+    single_cpu=$(push "{\"actions\":[${actions%,}]}")
+    batch_cpu=$(push "{\"actions\":[{\"account\":\"${CONTRACT}\",\"name\":\"transfers\",\"authorization\":[{\"actor\":\"${FROM}\",\"permission\":\"active\"}],\"data\":{\"from\":\"${FROM}\",\"transfers\":[${entries%,}]}}]}")
+
+    echo "${round}, ${single_cpu}, ${batch_cpu}, $((single_cpu / N)), $((batch_cpu / N))"
+done
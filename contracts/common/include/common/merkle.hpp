@@ -0,0 +1,71 @@
+// merkle.hpp
+
+#pragma once
+
+#include <eosio/crypto.hpp>
+#include <eosio/datastream.hpp>
+
+#include <array>
+#include <cstring>
+#include <tuple>
+#include <vector>
+
+namespace merkle
+{
+    using eosio::checksum256;
+
+    /**
+     * Hashes the fields of a leaf
+     *
+     * @details The fields are packed with the eosio serializer and hashed twice, so that a leaf can never be
+     * confused with an intermediate node of the tree. Off-chain tree builders must use the same encoding.
+     *
+     * @param fields - the fields of the leaf, in order
+     * @returns the leaf hash
+     */
+    template <typename... Fields>
+    checksum256 hash_leaf(const Fields &...fields)
+    {
+        std::vector<char> packed = eosio::pack(std::make_tuple(fields...));
+        checksum256 hash = eosio::sha256(packed.data(), packed.size());
+        std::array<uint8_t, 32> bytes = hash.extract_as_byte_array();
+        return eosio::sha256(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+    }
+
+    /**
+     * Hashes two nodes into their parent node
+     *
+     * @details The nodes are sorted before hashing, so proofs do not need to encode whether each sibling is on the left or right.
+     */
+    inline checksum256 hash_pair(const checksum256 &a, const checksum256 &b)
+    {
+        const checksum256 &first = a < b ? a : b;
+        const checksum256 &second = a < b ? b : a;
+
+        std::array<uint8_t, 32> first_bytes = first.extract_as_byte_array();
+        std::array<uint8_t, 32> second_bytes = second.extract_as_byte_array();
+
+        char buffer[64];
+        std::memcpy(buffer, first_bytes.data(), 32);
+        std::memcpy(buffer + 32, second_bytes.data(), 32);
+        return eosio::sha256(buffer, sizeof(buffer));
+    }
+
+    /**
+     * Checks that a leaf is part of the tree with the given root
+     *
+     * @param leaf - the leaf hash, see hash_leaf()
+     * @param proof - the sibling hashes from the leaf up to the root
+     * @param root - the root of the tree
+     * @returns true if the proof is valid
+     */
+    inline bool verify_proof(const checksum256 &leaf, const std::vector<checksum256> &proof, const checksum256 &root)
+    {
+        checksum256 node = leaf;
+        for (const checksum256 &sibling : proof)
+        {
+            node = hash_pair(node, sibling);
+        }
+        return node == root;
+    }
+}
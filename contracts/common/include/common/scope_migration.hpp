@@ -0,0 +1,87 @@
+// scope_migration.hpp
+
+#pragma once
+
+#include <eosio/name.hpp>
+
+#include <algorithm>
+#include <cstdint>
+
+namespace scope_migration
+{
+    using eosio::name;
+
+    /**
+     * Result of migrating (part of) one scope
+     *
+     * @param rows - the number of rows migrated in the scope
+     * @param done - true if the scope has no rows left to migrate
+     */
+    struct scope_result
+    {
+        uint32_t rows;
+        bool done;
+    };
+
+    /**
+     * Result of one call to migrate()
+     *
+     * @param cursor - the primary key of the next scope to migrate, to be stored for the next call
+     * @param rows - the number of rows migrated
+     * @param complete - true if every scope in the registry has been migrated
+     */
+    struct migration_result
+    {
+        uint64_t cursor;
+        uint32_t rows;
+        bool complete;
+    };
+
+    /**
+     * Migrates the scopes listed in a registry table, resuming from a cursor and stopping at a row budget
+     *
+     * @details Contracts cannot list the scopes of a table, so the scopes to migrate are kept in a registry table
+     * whose primary key is the scope value. Scopes are visited in primary key order and migrate_scope is called
+     * with the scope and the remaining budget. A scope that is not done is resumed on the next call.
+     * Every scope visited costs at least one row of the budget, so a call is bounded even when most scopes
+     * have nothing left to migrate.
+     *
+     * @param registry - the registry table, a multi_index with a `name scope` column as primary key
+     * @param cursor - the primary key of the first scope to migrate, as returned by the previous call
+     * @param row_budget - the maximum number of rows to migrate
+     * @param migrate_scope - called as migrate_scope(name scope, uint32_t budget) and returns a scope_result
+     * @returns the new cursor, the number of rows migrated and whether the migration is complete
+     */
+    template <typename Registry, typename MigrateScope>
+    migration_result migrate(const Registry &registry, uint64_t cursor, uint32_t row_budget, MigrateScope &&migrate_scope)
+    {
+        migration_result result{cursor, 0, false};
+
+        auto itr = registry.lower_bound(cursor);
+        while (itr != registry.end() && row_budget > 0)
+        {
+            scope_result scope = migrate_scope(itr->scope, row_budget);
+
+            result.rows += scope.rows;
+            row_budget -= std::min(std::max<uint32_t>(scope.rows, 1), row_budget);
+
+            if (!scope.done)
+            {
+                result.cursor = itr->scope.value;
+                return result;
+            }
+            ++itr;
+        }
+
+        if (itr == registry.end())
+        {
+            result.complete = true;
+            result.cursor = 0;
+        }
+        else
+        {
+            result.cursor = itr->scope.value;
+        }
+        return result;
+    }
+}
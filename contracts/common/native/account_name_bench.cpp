@@ -0,0 +1,152 @@
+// account_name_bench.cpp
+//
+// Checks that generating an account name on the 64 bit name encoding gives the same names as the std::string round trip
+// it replaced, wherever the old generator gave a full name, and compares their speed
+
+#include <tonomy/name_encoding.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+namespace
+{
+    using namespace tonomysystem;
+
+    // Native copies of the eosio::name conversions used by the std::string generator
+    uint64_t char_to_value(char c)
+    {
+        if (c == '.') return 0;
+        if (c >= '1' && c <= '5') return (c - '1') + 1;
+        if (c >= 'a' && c <= 'z') return (c - 'a') + 6;
+        return 0;
+    }
+
+    std::string name_to_string(uint64_t value)
+    {
+        static const char *charmap = ".12345abcdefghijklmnopqrstuvwxyz";
+        std::string str(13, '.');
+        uint64_t tmp = value;
+        for (int i = 0; i < 13; i++)
+        {
+            char c = charmap[tmp & (i == 0 ? 0x0f : 0x1f)];
+            str[12 - i] = c;
+            tmp >>= (i == 0 ? 4 : 5);
+        }
+        str.erase(str.find_last_not_of('.') + 1);
+        return str;
+    }
+
+    uint64_t string_to_name(const std::string &str)
+    {
+        uint64_t value = 0;
+        for (size_t i = 0; i < str.size() && i < 12; i++)
+        {
+            value |= (char_to_value(str[i]) & 0x1f) << (64 - 5 * (i + 1));
+        }
+        return value;
+    }
+
+    // The generator before it worked on the name encoding
+    uint64_t string_tidy_name(uint64_t value, uint8_t random_number, char letter)
+    {
+        static const char *charmap = "12345abcdefghijklmnopqrstuvwxyz";
+        std::string name_string = name_to_string(value);
+        name_string[0] = letter;
+        for (size_t i = 0; i < name_string.length(); i++)
+        {
+            if (name_string[i] == '.')
+            {
+                name_string[i] = charmap[(random_number * i) % 31];
+            }
+        }
+        name_string.erase(name_string.end() - 1);
+        return string_to_name(name_string);
+    }
+
+    uint64_t encoding_tidy_name(uint64_t value, uint8_t random_number, char letter)
+    {
+        return tidy_name_value(value, random_number, char_to_value(letter));
+    }
+
+    // The splitmix64 finalizer, as used by random_account_name
+    uint64_t mix_uint64_t(uint64_t value)
+    {
+        value += 0x9e3779b97f4a7c15;
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111eb;
+        return value ^ (value >> 31);
+    }
+
+    // The old generator only gave a full 12 character name when the 13th character was not empty.
+    // Otherwise it trimmed the trailing dots and then dropped the last real character, which the new one fixes.
+    bool string_generator_valid(uint64_t value)
+    {
+        return (value & 0x0F) != 0;
+    }
+
+    // Returns the number of inputs where both generators are valid and differ
+    int compare_generators(int names, int &compared)
+    {
+        int mismatches = 0;
+        uint64_t value = 0;
+        for (int i = 0; i < names; i++)
+        {
+            value = mix_uint64_t(value);
+            for (char letter : {'p', 'a', 'o', 'g', 's'})
+            {
+                if (!string_generator_valid(value))
+                {
+                    continue;
+                }
+                compared++;
+                uint64_t expected = string_tidy_name(value, uint8_t(value), letter);
+                uint64_t actual = encoding_tidy_name(value, uint8_t(value), letter);
+                if (expected != actual && mismatches++ < 10)
+                {
+                    std::printf("mismatch for %llx: %s != %s\n", static_cast<unsigned long long>(value),
+                                name_to_string(expected).c_str(), name_to_string(actual).c_str());
+                }
+            }
+        }
+        return mismatches;
+    }
+
+    template <typename TidyName>
+    double nanoseconds_per_name(TidyName &&tidy_name, int names, uint64_t &checksum)
+    {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t value = 0;
+        for (int i = 0; i < names; i++)
+        {
+            value = mix_uint64_t(value);
+            checksum ^= tidy_name(value, uint8_t(value), 'p');
+        }
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(end - start).count() / names;
+    }
+}
+
+int main()
+{
+    const int names = 1000000;
+
+    int compared = 0;
+    int mismatches = compare_generators(names, compared);
+    if (mismatches > 0)
+    {
+        std::printf("%d of %d names differ from the std::string generator\n", mismatches, compared);
+        return 1;
+    }
+    std::printf("%d names match the std::string generator\n", compared);
+
+    uint64_t string_checksum = 0;
+    uint64_t encoding_checksum = 0;
+
+    double string_ns = nanoseconds_per_name(string_tidy_name, names, string_checksum);
+    double encoding_ns = nanoseconds_per_name(encoding_tidy_name, names, encoding_checksum);
+
+    std::printf("std::string round trip: %6.1f ns per name (checksum %llx)\n", string_ns, static_cast<unsigned long long>(string_checksum));
+    std::printf("name encoding:          %6.1f ns per name (checksum %llx)\n", encoding_ns, static_cast<unsigned long long>(encoding_checksum));
+    return 0;
+}
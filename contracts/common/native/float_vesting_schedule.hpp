@@ -0,0 +1,22 @@
+// float_vesting_schedule.hpp
+
+#pragma once
+
+#include <vesting.tmy/vesting_schedule.hpp>
+
+#include <algorithm>
+
+namespace vestingtoken
+{
+    // The floating point schedule as withdraw() evaluated it before vested_amount(), used as the reference
+    inline int64_t float_vested_amount(const vesting_category &category, int64_t tokens_allocated, int64_t since_vesting_start)
+    {
+        if (since_vesting_start < category.cliff_period) return 0;
+        if (since_vesting_start >= category.vesting_period) return tokens_allocated;
+
+        double tge_unlock = static_cast<double>(category.tge_unlock) / BASIS_POINTS;
+        double vesting_finished = static_cast<double>(since_vesting_start) / category.vesting_period;
+        int64_t claimable = tokens_allocated * ((1.0 - tge_unlock) * vesting_finished + tge_unlock);
+        return std::min(claimable, tokens_allocated);
+    }
+}
@@ -0,0 +1,94 @@
+// vesting_categories_bench.cpp
+//
+// Compares the cost of looking up a vesting category when every action starts with a new WASM instance.
+// The std::map tables were global objects, so their constructors allocated every node before each action ran.
+// The constexpr table has no constructor and a lookup is an index into static data.
+
+#include <vesting.tmy/vesting_schedule.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <map>
+
+namespace
+{
+    using namespace vestingtoken;
+
+    // The tables as they were before the constexpr table
+    struct map_vesting_category
+    {
+        int64_t cliff_period;
+        int64_t start_delay;
+        int64_t vesting_period;
+        double tge_unlock;
+    };
+
+    int64_t days(int64_t count) { return count * DAY_MICROSECONDS; }
+
+    int64_t map_lookup(int category_id)
+    {
+        // Constructed on every call, like the globals were on every action
+        const std::map<int, map_vesting_category> vesting_categories = {
+            {1, {days(6 * 30), days(0 * 30), days(2 * 365), 0.0}},
+            {2, {days(6 * 30), days(6 * 30), days(2 * 365), 0.0}},
+            {3, {days(0 * 30), days(0 * 30), days(0 * 30), 0.0}},
+            {5, {days(0 * 30), days(0 * 30), days(1 * 365), 0.0}},
+            {4, {days(0 * 30), days(1 * 365), days(5 * 365), 0.0}},
+            {6, {days(0 * 30), days(0 * 30), days(2 * 365), 0.0}},
+            {7, {days(0 * 30), days(0 * 30), days(5 * 365), 0.0}},
+            {8, {days(0 * 30), days(6 * 30), days(12 * 30), 0.05}},
+            {9, {days(0 * 30), days(4 * 30), days(12 * 30), 0.075}},
+            {10, {days(0 * 30), days(1 * 30), days(3 * 30), 0.25}},
+            {11, {days(0 * 30), days(3 * 30), days(9 * 30), 0.125}},
+            {12, {days(0 * 30), days(1 * 30), days(3 * 30), 0.25}},
+            {13, {days(0 * 30), days(0 * 30), days(6 * 30), 0.7}},
+            {14, {days(0 * 30), days(0 * 30), days(6 * 30), 0.25}},
+        };
+        const std::map<int, bool> depreciated_categories = {{1, true}, {2, true}};
+
+        auto itr = vesting_categories.find(category_id);
+        if (itr == vesting_categories.end() || depreciated_categories.count(category_id) > 0)
+            return -1;
+        return itr->second.vesting_period;
+    }
+
+    int64_t table_lookup(int category_id)
+    {
+        const vesting_category *category = find_vesting_category(category_id);
+        if (category == nullptr || category->depreciated)
+            return -1;
+        return category->vesting_period;
+    }
+
+    template <typename Lookup>
+    double nanoseconds_per_action(Lookup &&lookup, int actions, int64_t &checksum)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < actions; i++)
+        {
+            checksum += lookup(i % MAX_VESTING_CATEGORY_ID + 1);
+        }
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(end - start).count() / actions;
+    }
+}
+
+int main()
+{
+    const int actions = 200000;
+    int64_t map_checksum = 0;
+    int64_t table_checksum = 0;
+
+    double map_ns = nanoseconds_per_action(map_lookup, actions, map_checksum);
+    double table_ns = nanoseconds_per_action(table_lookup, actions, table_checksum);
+
+    if (map_checksum != table_checksum)
+    {
+        std::printf("lookups disagree: map %lld, table %lld\n", static_cast<long long>(map_checksum), static_cast<long long>(table_checksum));
+        return 1;
+    }
+
+    std::printf("std::map tables, built per action: %8.1f ns per action\n", map_ns);
+    std::printf("constexpr table:                    %8.1f ns per action\n", table_ns);
+    return 0;
+}
@@ -0,0 +1,48 @@
+// vesting_schedule_bench.cpp
+//
+// Compares vested_amount() in 128 bit integer arithmetic with the floating point schedule it replaced.
+// On chain, doubles are emulated in software, so the native ratio understates the cost of the float version.
+
+#include <vesting.tmy/vesting_schedule.hpp>
+#include "float_vesting_schedule.hpp"
+
+#include <chrono>
+#include <cstdio>
+
+namespace
+{
+    using namespace vestingtoken;
+
+    template <typename VestedAmount>
+    double nanoseconds_per_call(VestedAmount &&vested, int rounds, int64_t &checksum)
+    {
+        auto start = std::chrono::steady_clock::now();
+        int calls = 0;
+        for (int round = 0; round < rounds; round++)
+        {
+            for (const vesting_category &category : vesting_categories)
+            {
+                // Times spread across the whole window, so most calls take the linear branch
+                int64_t since_vesting_start = category.vesting_period * (round % 1000) / 1000;
+                checksum += vested(category, 1000000000000 + round, since_vesting_start);
+                calls++;
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(end - start).count() / calls;
+    }
+}
+
+int main()
+{
+    const int rounds = 200000;
+    int64_t integer_checksum = 0;
+    int64_t float_checksum = 0;
+
+    double integer_ns = nanoseconds_per_call(vested_amount, rounds, integer_checksum);
+    double float_ns = nanoseconds_per_call(float_vested_amount, rounds, float_checksum);
+
+    std::printf("vested_amount(), 128 bit integer: %6.1f ns per call (checksum %lld)\n", integer_ns, static_cast<long long>(integer_checksum));
+    std::printf("float schedule:                   %6.1f ns per call (checksum %lld)\n", float_ns, static_cast<long long>(float_checksum));
+    return 0;
+}
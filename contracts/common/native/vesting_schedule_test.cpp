@@ -0,0 +1,90 @@
+// vesting_schedule_test.cpp
+//
+// Checks vested_amount() against the floating point schedule it replaced, for every category across its vesting window
+
+#include <vesting.tmy/vesting_schedule.hpp>
+#include "float_vesting_schedule.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+    using namespace vestingtoken;
+
+    // Spot checks at the cliff, the midpoint and the end of the vesting window of every category
+    constexpr bool check_spot_values()
+    {
+        // Divisible by 2 * BASIS_POINTS so the midpoint amount is exact
+        constexpr int64_t tokens_allocated = 2 * BASIS_POINTS * 1000000;
+        for (const vesting_category &category : vesting_categories)
+        {
+            int64_t tge_amount = tokens_allocated / BASIS_POINTS * category.tge_unlock;
+
+            if (category.cliff_period > 0 && vested_amount(category, tokens_allocated, category.cliff_period - 1) != 0) return false;
+            if (category.cliff_period < category.vesting_period)
+            {
+                __int128 cliff_amount = tge_amount + static_cast<__int128>(tokens_allocated - tge_amount) * category.cliff_period / category.vesting_period;
+                if (vested_amount(category, tokens_allocated, category.cliff_period) != cliff_amount) return false;
+            }
+            if (category.vesting_period > 0 && category.vesting_period / 2 >= category.cliff_period &&
+                vested_amount(category, tokens_allocated, category.vesting_period / 2) != tge_amount + (tokens_allocated - tge_amount) / 2)
+                return false;
+            if (vested_amount(category, tokens_allocated, category.vesting_period) != tokens_allocated) return false;
+            if (vested_amount(category, tokens_allocated, MAX_VESTING_PERIOD) != tokens_allocated) return false;
+        }
+        return true;
+    }
+
+    static_assert(check_spot_values(), "vested_amount() must be 0 before the cliff, linear after the TGE unlock and complete at the end");
+
+    constexpr int64_t allocations[] = {1, 3, 999, 1000000, 123456789, 50000000000000, 1000000000000000};
+    constexpr int steps = 2000;
+
+    int failures = 0;
+
+    void expect(bool condition, const vesting_category &category, int64_t tokens_allocated, int64_t since_vesting_start, const char *message)
+    {
+        if (condition) return;
+        failures++;
+        std::printf("category %d, allocated %lld, time %lld: %s\n", category.id, static_cast<long long>(tokens_allocated),
+                    static_cast<long long>(since_vesting_start), message);
+    }
+
+    void sweep(const vesting_category &category, int64_t tokens_allocated)
+    {
+        int64_t previous = 0;
+        for (int step = -1; step <= steps + 1; step++)
+        {
+            int64_t since_vesting_start = category.vesting_period * step / steps;
+            int64_t vested = vested_amount(category, tokens_allocated, since_vesting_start);
+            int64_t float_vested = float_vested_amount(category, tokens_allocated, since_vesting_start);
+
+            expect(vested >= 0 && vested <= tokens_allocated, category, tokens_allocated, since_vesting_start, "vested amount out of range");
+            expect(vested >= previous, category, tokens_allocated, since_vesting_start, "vested amount decreased");
+            expect(std::llabs(vested - float_vested) <= 1, category, tokens_allocated, since_vesting_start, "differs from the float schedule by more than 1 unit");
+            previous = vested;
+        }
+        expect(vested_amount(category, tokens_allocated, category.vesting_period) == tokens_allocated, category, tokens_allocated,
+               category.vesting_period, "allocation not fully vested at the end");
+    }
+}
+
+int main()
+{
+    for (const vesting_category &category : vesting_categories)
+    {
+        for (int64_t tokens_allocated : allocations)
+        {
+            sweep(category, tokens_allocated);
+        }
+    }
+
+    if (failures > 0)
+    {
+        std::printf("%d failures\n", failures);
+        return 1;
+    }
+    std::printf("checked %zu categories\n", vesting_categories.size());
+    return 0;
+}
@@ -1,9 +1,14 @@
 #pragma once
 
 #include <eosio/asset.hpp>
+#include <eosio/crypto.hpp>
 #include <eosio/eosio.hpp>
+#include <eosio/singleton.hpp>
+#include <common/merkle.hpp>
 
+#include <algorithm>
 #include <string>
+#include <vector>
 
 namespace eosiosystem {
    class system_contract;
@@ -27,6 +32,11 @@ namespace eosio {
          using contract::contract;
          static constexpr eosio::symbol SYSTEM_RESOURCE_CURRENCY = eosio::symbol("TONO", 6);
          static constexpr eosio::symbol SYSTEM_RESOURCE_CURRENCY_OLD = eosio::symbol("LEOS", 6);
+         static constexpr uint32_t MAX_MIGRATE_BATCH_SIZE = 500;
+         static constexpr uint8_t MAX_PROOF_LENGTH = 32;
+         static constexpr uint8_t MAX_FEED_CAPACITY = 50;
+         // Number of most recent checkpoint epochs that balanceat and supplyat can read
+         static constexpr uint64_t CHECKPOINT_RETENTION_EPOCHS = 32;
 
          /**
           * Allows `issuer` account to create a token in supply of `maximum_supply`. If validation is successful a new entry in statstable for token symbol scope gets created.
@@ -76,6 +86,130 @@ namespace eosio {
                         const name&    to,
                         const asset&   quantity,
                         const string&  memo );
+
+         struct transfer_entry {
+            name     to;
+            asset    quantity;
+            string   memo;
+         };
+
+         /**
+          * Allows `from` account to transfer tokens of one symbol to many accounts.
+          * `from` is debited once with the total and each `to` account is credited with its quantity.
+          * Each `to` account is notified of the action, as with transfer.
+          *
+          * The stats lookup, the auth check and the debit of `from` are done once. Each entry adds an is_account check,
+          * a notification, one add_balance() (see sub_balance() for its table operations) and an append_feed()
+          * for `from` and for `to`. Each notified contract that handles the transfer also runs once per entry.
+          * blockchain/bench-transfers.sh measures the CPU per recipient against one transfer action per recipient.
+          *
+          * @param from - the account to transfer from,
+          * @param transfers - the accounts to be transferred to, with the quantity and memo of each transfer.
+          *
+          * @pre All quantities must have the same symbol.
+          */
+         [[eosio::action]]
+         void transfers( const name& from, const std::vector<transfer_entry>& transfers );
+
+         /**
+          * Creates an airdrop that recipients claim with a Merkle proof. The `total` is moved from the `issuer` balance into escrow.
+          *
+          * Each leaf of the tree is merkle::hash_leaf(id, index, account, amount) with amount as the int64 token amount.
+          *
+          * @param id - the id of the airdrop,
+          * @param issuer - the account that funds the airdrop,
+          * @param root - the Merkle root of the (account, amount) leaves,
+          * @param total - the sum of the amounts of all leaves,
+          * @param leaves - the number of leaves in the tree.
+          */
+         [[eosio::action]]
+         void setairdrop( uint64_t id, const name& issuer, const checksum256& root, const asset& total, uint64_t leaves );
+
+         /**
+          * Claims the tokens of `account` from an airdrop. The account pays for the RAM of its balance.
+          *
+          * @param id - the id of the airdrop,
+          * @param index - the index of the account's leaf in the tree,
+          * @param account - the account that receives the tokens,
+          * @param amount - the quantity of tokens in the leaf,
+          * @param proof - the sibling hashes from the leaf up to the root.
+          */
+         [[eosio::action]]
+         void claimdrop( uint64_t id, uint64_t index, const name& account, const asset& amount, const std::vector<checksum256>& proof );
+
+         /**
+          * Closes an airdrop and returns the unclaimed tokens to the issuer.
+          *
+          * @param id - the id of the airdrop.
+          */
+         [[eosio::action]]
+         void closedrop( uint64_t id );
+
+         /**
+          * Opens a feed of the most recent transfers sent or received by `owner`, stored in the `owner` scope.
+          * The owner pays for the RAM of all `capacity` entries up front, new transfers overwrite the oldest entry.
+          *
+          * @param owner - the account to keep the feed of,
+          * @param capacity - the number of transfers kept, at most MAX_FEED_CAPACITY.
+          */
+         [[eosio::action]]
+         void feedopen( const name& owner, uint8_t capacity );
+
+         /**
+          * Closes the transfer feed of `owner` and frees its RAM.
+          *
+          * @param owner - the account to close the feed of.
+          */
+         [[eosio::action]]
+         void feedclose( const name& owner );
+
+         /**
+          * Opens a payment channel from `payer` to `payee`, moving `quantity` from the `payer` balance into the channel.
+          *
+          * The payer pays the payee off-chain by signing vouchers with `key` for the cumulative amount owed,
+          * see voucher_digest() for the signed data.
+          *
+          * @param payer - the account that funds the channel,
+          * @param payee - the account that is paid through the channel,
+          * @param key - the public key that signs the vouchers,
+          * @param quantity - the quantity of tokens locked in the channel,
+          * @param timeout_seconds - the time after which the payer can take back the unsettled tokens.
+          * @returns the id of the channel
+          */
+         [[eosio::action]]
+         uint64_t openchannel( const name& payer, const name& payee, const public_key& key, const asset& quantity, uint32_t timeout_seconds );
+
+         /**
+          * Pays the payee of a channel the cumulative amount of a voucher, less what has already been settled.
+          * The channel is closed when all of its tokens have been paid.
+          *
+          * @param id - the id of the channel,
+          * @param amount - the cumulative amount of the voucher,
+          * @param sig - the signature of the voucher by the channel key.
+          */
+         [[eosio::action]]
+         void settle( uint64_t id, const asset& amount, const signature& sig );
+
+         /**
+          * Closes a channel after its timeout and returns the unsettled tokens to the payer.
+          *
+          * @param id - the id of the channel.
+          */
+         [[eosio::action]]
+         void refund( uint64_t id );
+
+         /**
+          * Returns the digest that the channel key signs for a voucher of a cumulative `amount`
+          *
+          * Channel ids are never reused and the digest also covers the payer, the payee and the key,
+          * so a voucher can only be settled on the channel it was signed for.
+          */
+         static checksum256 voucher_digest( const name& token_contract_account, uint64_t id, const name& payer, const name& payee,
+                                            const public_key& key, const asset& amount )
+         {
+            std::vector<char> packed = eosio::pack( std::make_tuple( token_contract_account, id, payer, payee, key, amount ) );
+            return eosio::sha256( packed.data(), packed.size() );
+         }
          /**
           * Allows `ram_payer` to create an account `owner` with zero balance for
           * token `symbol` at the expense of `ram_payer`.
@@ -105,6 +239,9 @@ namespace eosio {
 
          /**
           * Migrates an accounts tokens from the old symbol to the new symbol
+          *
+          * Balances are also migrated when the account next sends or receives tokens,
+          * this is only needed for accounts that have not been used since.
           */
          [[eosio::action]]
          void migrateacc(const name &account);
@@ -115,6 +252,64 @@ namespace eosio {
          [[eosio::action]]
          void migratestats();
 
+         /**
+          * Sets the holder index entries of accounts from their balances in the system currency.
+          * Used for accounts whose balance has not changed since the holder index was introduced.
+          *
+          * @param accounts_to_sync - the accounts to index
+          */
+         [[eosio::action]]
+         void syncholders(const std::vector<name>& accounts_to_sync);
+
+         /**
+          * Starts a new checkpoint epoch. Balances and the supply of the system currency at the start of the epoch
+          * can later be read with balanceat and supplyat, for the last CHECKPOINT_RETENTION_EPOCHS epochs.
+          *
+          * The first balance change of an account in each epoch writes a checkpoint row, billed to the account
+          * that pays for the change: the sender when debited and the RAM payer of the credit when credited.
+          * Older rows are erased when an account writes a new one, so an account holds at most
+          * CHECKPOINT_RETENTION_EPOCHS rows, and the supply scope the same.
+          *
+          * @returns the new epoch
+          */
+         [[eosio::action]]
+         uint64_t newepoch();
+
+         /**
+          * Returns the balance of `account` in the system currency at the start of a checkpoint epoch
+          *
+          * @param account - the account to read the balance of,
+          * @param epoch - the checkpoint epoch, it must have started and be one of the last CHECKPOINT_RETENTION_EPOCHS.
+          */
+         [[eosio::action, eosio::read_only]]
+         asset balanceat( const name& account, uint64_t epoch );
+
+         /**
+          * Returns the supply of the system currency at the start of a checkpoint epoch
+          *
+          * @param epoch - the checkpoint epoch, it must have started and be one of the last CHECKPOINT_RETENTION_EPOCHS.
+          */
+         [[eosio::action, eosio::read_only]]
+         asset supplyat( uint64_t epoch );
+
+         /**
+          * Adds accounts to the list of scopes visited by the migrate action
+          *
+          * @param scopes - the accounts that may hold a balance in the old symbol
+          */
+         [[eosio::action]]
+         void regscopes(const std::vector<name>& scopes);
+
+         /**
+          * Migrates the balances of the registered accounts from the old symbol to the new symbol,
+          * continuing from where the previous call stopped. Call repeatedly until it returns true.
+          *
+          * @param batch_size - the maximum number of accounts to visit
+          * @returns true if all registered accounts have been migrated
+          */
+         [[eosio::action]]
+         bool migrate(uint32_t batch_size);
+
          static asset get_supply( const name& token_contract_account, const symbol_code& sym_code )
          {
             stats statstable( token_contract_account, sym_code.raw() );
@@ -133,6 +328,7 @@ namespace eosio {
          using issue_action = eosio::action_wrapper<"issue"_n, &token::issue>;
          using retire_action = eosio::action_wrapper<"retire"_n, &token::retire>;
          using transfer_action = eosio::action_wrapper<"transfer"_n, &token::transfer>;
+         using transfers_action = eosio::action_wrapper<"transfers"_n, &token::transfers>;
          using open_action = eosio::action_wrapper<"open"_n, &token::open>;
          using close_action = eosio::action_wrapper<"close"_n, &token::close>;
       private:
@@ -150,9 +346,182 @@ namespace eosio {
             uint64_t primary_key()const { return supply.symbol.code().raw(); }
          };
 
+         // Accounts to visit in the migrate action, contract scoped
+         struct [[eosio::table]] migration_scope {
+            name     scope;
+
+            uint64_t primary_key()const { return scope.value; }
+         };
+
+         struct [[eosio::table]] migration_state {
+            uint64_t cursor = 0;    // the first scope not yet migrated
+            uint64_t migrated = 0;  // the number of balances migrated by the migrate action
+            bool     complete = false;
+         };
+
+         // Contract scoped
+         struct [[eosio::table]] airdrop {
+            uint64_t    id;
+            name        issuer;
+            checksum256 root;     // the Merkle root of the (account, amount) leaves
+            asset       total;    // held in escrow by the contract until claimed or closed
+            asset       claimed;
+            uint64_t    leaves;   // the number of leaves in the tree
+            bool        closed;
+
+            uint64_t primary_key()const { return id; }
+         };
+
+         // Bitmap of the claimed leaves of an airdrop, scoped by airdrop id. Each row holds 64 leaves.
+         struct [[eosio::table]] airdrop_claims {
+            uint64_t word;  // the leaf index divided by 64
+            uint64_t bits;  // bit (index % 64) is set if the leaf has been claimed
+
+            uint64_t primary_key()const { return word; }
+         };
+
+         // Balance in the system currency of each account with a balance row, contract scoped
+         struct [[eosio::table]] holder {
+            name     account;
+            int64_t  balance;
+
+            uint64_t primary_key()const { return account.value; }
+            uint64_t by_balance()const { return static_cast<uint64_t>(balance); }
+         };
+
+         struct [[eosio::table]] holder_stats {
+            uint64_t holders = 0;  // the number of accounts with a balance row
+            uint64_t nonzero = 0;  // the number of accounts with a balance greater than zero
+         };
+
+         // Contract scoped
+         struct [[eosio::table]] channel {
+            uint64_t       id;
+            name           payer;
+            name           payee;
+            public_key     key;       // signs the vouchers of the payer
+            asset          deposit;   // locked when the channel was opened
+            asset          settled;   // paid to the payee so far
+            time_point_sec expires;   // after which the payer can refund the unsettled tokens
+
+            uint64_t primary_key()const { return id; }
+         };
+
+         struct [[eosio::table]] channel_state {
+            uint64_t next_id = 0;  // the id of the next channel, never decreases
+         };
+
+         // Written on the first change of a balance or of the supply in each checkpoint epoch
+         struct [[eosio::table]] checkpoint {
+            uint64_t epoch;
+            int64_t  amount;  // the amount at the start of the epoch
+
+            uint64_t primary_key()const { return epoch; }
+         };
+
+         struct [[eosio::table]] checkpoint_state {
+            uint64_t       epoch = 0;  // 0 until the first newepoch, no checkpoints are written before
+            time_point_sec started;
+         };
+
+         // Scoped by owner, one row per slot of the ring buffer
+         struct [[eosio::table]] feed_entry {
+            uint64_t       slot;
+            uint64_t       seq;  // 0 for a slot that has not been written yet
+            name           from;
+            name           to;
+            asset          quantity;
+            time_point_sec time;
+
+            uint64_t primary_key()const { return slot; }
+         };
+
+         // Scoped by owner
+         struct [[eosio::table]] feed_state {
+            uint8_t  capacity;
+            uint64_t next_seq;  // the sequence number of the next transfer, written to slot next_seq % capacity
+         };
+
          typedef eosio::multi_index< "accounts"_n, account > accounts;
+         typedef eosio::multi_index< "feed"_n, feed_entry > feed;
+         typedef eosio::singleton< "feedstate"_n, feed_state > feed_state_table;
+         // Following line needed to correctly generate ABI. See https://github.com/EOSIO/eosio.cdt/issues/280#issuecomment-439666574
+         typedef eosio::multi_index< "feedstate"_n, feed_state > feed_state_table_dump;
+         // Scoped by account
+         typedef eosio::multi_index< "checkpoints"_n, checkpoint > balance_checkpoints;
+         // Contract scoped
+         typedef eosio::multi_index< "supplychkpts"_n, checkpoint > supply_checkpoints;
+         typedef eosio::singleton< "chkptstate"_n, checkpoint_state > checkpoint_state_table;
+         // Following line needed to correctly generate ABI. See https://github.com/EOSIO/eosio.cdt/issues/280#issuecomment-439666574
+         typedef eosio::multi_index< "chkptstate"_n, checkpoint_state > checkpoint_state_table_dump;
+         typedef eosio::multi_index< "channels"_n, channel > channels;
+         typedef eosio::singleton< "chanstate"_n, channel_state > channel_state_table;
+         // Following line needed to correctly generate ABI. See https://github.com/EOSIO/eosio.cdt/issues/280#issuecomment-439666574
+         typedef eosio::multi_index< "chanstate"_n, channel_state > channel_state_table_dump;
+         typedef eosio::multi_index< "holders"_n, holder,
+            indexed_by< "bybalance"_n, const_mem_fun< holder, uint64_t, &holder::by_balance > >
+         > holders;
+         typedef eosio::singleton< "holderstats"_n, holder_stats > holder_stats_table;
+         // Following line needed to correctly generate ABI. See https://github.com/EOSIO/eosio.cdt/issues/280#issuecomment-439666574
+         typedef eosio::multi_index< "holderstats"_n, holder_stats > holder_stats_table_dump;
+         typedef eosio::multi_index< "airdrops"_n, airdrop > airdrops;
+         typedef eosio::multi_index< "dropclaims"_n, airdrop_claims > airdrop_claims_table;
          typedef eosio::multi_index< "stat"_n, currency_stats > stats;
+         typedef eosio::multi_index< "migscopes"_n, migration_scope > migration_scopes;
+         typedef eosio::singleton< "migration"_n, migration_state > migration_table;
+         // Following line needed to correctly generate ABI. See https://github.com/EOSIO/eosio.cdt/issues/280#issuecomment-439666574
+         typedef eosio::multi_index< "migration"_n, migration_state > migration_table_dump;
+
+         /**
+          * Converts the balance of an account in the old symbol to the new symbol
+          *
+          * @returns the number of balances migrated, 0 or 1
+          */
+         uint32_t migrate_balance( const name& account );
 
+         /**
+          * Erases the balance of an account in the old symbol, if there is one
+          *
+          * @param acnts - the accounts table of the account
+          * @param amount - set to the amount of the erased balance
+          * @returns true if a balance in the old symbol was found
+          */
+         bool take_legacy_balance( accounts& acnts, int64_t& amount );
+
+         /**
+          * Updates the holder index entry of an account and the holder counters, if the balance is in the system currency
+          *
+          * @param ram_payer - pays for a new holder entry, the same account that pays for the balance row
+          */
+         void update_holder( const name& owner, const asset& balance, const name& ram_payer );
+         void remove_holder( const name& owner );
+
+         /**
+          * Records the balance of an account, or the supply, before its first change in the current checkpoint epoch
+          */
+         void checkpoint_balance( const name& owner, const asset& balance_before, const name& ram_payer );
+         void checkpoint_supply( const asset& supply_before );
+
+         /**
+          * Overwrites the oldest entry of the transfer feed of `owner`, if it has one
+          */
+         void append_feed( const name& owner, const name& from, const name& to, const asset& quantity );
+
+         /**
+          * Debits or credits the balance of `owner`. A transfer calls each once, and append_feed() once per side.
+          *
+          * Table operations per side, for the system currency, against one find and one modify before the
+          * legacy migration, holder index, checkpoints and feed:
+          * - always: the balance find and modify, the legacy balance find, the chkptstate get, the holders find
+          *   and modify (and its bybalance index) and the feedstate find, so 5 finds and 2 modifies,
+          * - while a checkpoint epoch is running: one checkpoints find, and one emplace on the first change in the epoch
+          *   along with the erase of the checkpoints that left the retention window, one per emplace on average,
+          * - when the account has a feed: one feed row get and modify and one feedstate modify,
+          * - when the account joins the holders or its balance crosses zero: one holderstats get and set,
+          * - once per account: the legacy balance erase, when it has one.
+          * Other symbols skip the legacy, holder and checkpoint operations.
+          * These are counts of operations, the CPU time they add to a transfer has not been measured.
+          */
          void sub_balance( const name& owner, const asset& value );
          void add_balance( const name& owner, const asset& value, const name& ram_payer );
    };
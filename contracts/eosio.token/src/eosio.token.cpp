@@ -1,7 +1,45 @@
 #include <eosio.token/eosio.token.hpp>
+#include <common/scope_migration.hpp>
 
 namespace eosio
 {
+   void check_entry(bool condition, size_t index, const char *message)
+   {
+      if (!condition)
+      {
+         check(false, "Entry " + std::to_string(index) + ": " + message);
+      }
+   }
+
+   template <typename Checkpoints>
+   void write_checkpoint(Checkpoints &checkpoints, const name &payer, uint64_t epoch, int64_t amount)
+   {
+      // Only the first change in an epoch is recorded, later changes do not alter the amount at its start
+      if (checkpoints.find(epoch) != checkpoints.end())
+      {
+         return;
+      }
+
+      // Checkpoints of epochs that can no longer be read are erased, so a scope never holds more than the retention window
+      for (auto itr = checkpoints.begin(); itr != checkpoints.end() && itr->epoch + token::CHECKPOINT_RETENTION_EPOCHS <= epoch;)
+      {
+         itr = checkpoints.erase(itr);
+      }
+
+      checkpoints.emplace(payer, [&](auto &c)
+                          {
+         c.epoch = epoch;
+         c.amount = amount; });
+   }
+
+   template <typename Checkpoints>
+   int64_t read_checkpoint(const Checkpoints &checkpoints, uint64_t epoch, int64_t current)
+   {
+      // The first checkpoint at or after the epoch holds the amount at the start of the epoch,
+      // as the amount did not change in the epochs in between. Without one, it has not changed since.
+      auto itr = checkpoints.lower_bound(epoch);
+      return itr != checkpoints.end() ? itr->amount : current;
+   }
 
    void token::create(const name &issuer,
                       const asset &maximum_supply)
@@ -43,6 +81,7 @@ namespace eosio
       check(quantity.symbol == st.supply.symbol, "symbol precision mismatch");
       check(quantity.amount <= st.max_supply.amount - st.supply.amount, "quantity exceeds available supply");
 
+      checkpoint_supply(st.supply);
       statstable.modify(st, same_payer, [&](auto &s)
                         { s.supply += quantity; });
 
@@ -66,6 +105,7 @@ namespace eosio
 
       check(quantity.symbol == st.supply.symbol, "symbol precision mismatch");
 
+      checkpoint_supply(st.supply);
       statstable.modify(st, same_payer, [&](auto &s)
                         { s.supply -= quantity; });
 
@@ -97,33 +137,432 @@ namespace eosio
 
       sub_balance(from, quantity);
       add_balance(to, quantity, payer);
+
+      append_feed(from, from, to, quantity);
+      append_feed(to, from, to, quantity);
+   }
+
+   void token::transfers(const name &from, const std::vector<transfer_entry> &transfers)
+   {
+      check(!transfers.empty(), "no transfers provided");
+      require_auth(from);
+
+      auto sym = transfers[0].quantity.symbol;
+      stats statstable(get_self(), sym.code().raw());
+      const auto &st = statstable.get(sym.code().raw());
+      check(sym == st.supply.symbol, "symbol precision mismatch");
+
+      require_recipient(from);
+
+      asset total(0, sym);
+      for (size_t i = 0; i < transfers.size(); i++)
+      {
+         const transfer_entry &entry = transfers[i];
+
+         check_entry(entry.to != from, i, "cannot transfer to self");
+         check_entry(is_account(entry.to), i, "to account does not exist");
+         check_entry(entry.quantity.is_valid(), i, "invalid quantity");
+         check_entry(entry.quantity.amount > 0, i, "must transfer positive quantity");
+         check_entry(entry.quantity.symbol == sym, i, "symbol precision mismatch");
+         check_entry(entry.memo.size() <= 256, i, "memo has more than 256 bytes");
+
+         require_recipient(entry.to);
+         total += entry.quantity;
+      }
+
+      // Debit the sender once, before crediting, so an overdrawn sender fails before any row is created
+      sub_balance(from, total);
+
+      auto payer = get_self();
+      for (const transfer_entry &entry : transfers)
+      {
+         add_balance(entry.to, entry.quantity, payer);
+
+         append_feed(from, from, entry.to, entry.quantity);
+         append_feed(entry.to, from, entry.to, entry.quantity);
+      }
+   }
+
+   void token::setairdrop(uint64_t id, const name &issuer, const checksum256 &root, const asset &total, uint64_t leaves)
+   {
+      require_auth(issuer);
+      check(leaves > 0, "leaves must be greater than 0");
+
+      auto sym = total.symbol.code();
+      stats statstable(get_self(), sym.raw());
+      const auto &st = statstable.get(sym.raw(), "symbol does not exist");
+      check(total.is_valid(), "invalid quantity");
+      check(total.amount > 0, "must airdrop positive quantity");
+      check(total.symbol == st.supply.symbol, "symbol precision mismatch");
+
+      airdrops airdrops_table(get_self(), get_self().value);
+      check(airdrops_table.find(id) == airdrops_table.end(), "airdrop already exists");
+
+      // The total is held by the airdrop row until it is claimed or returned by closedrop
+      sub_balance(issuer, total);
+
+      airdrops_table.emplace(issuer, [&](auto &a)
+                             {
+         a.id = id;
+         a.issuer = issuer;
+         a.root = root;
+         a.total = total;
+         a.claimed = asset(0, total.symbol);
+         a.leaves = leaves;
+         a.closed = false; });
+   }
+
+   void token::claimdrop(uint64_t id, uint64_t index, const name &account, const asset &amount, const std::vector<checksum256> &proof)
+   {
+      // The account pays for the RAM of its balance and of the claims row
+      require_auth(account);
+      check(proof.size() <= MAX_PROOF_LENGTH, "proof is too long");
+
+      airdrops airdrops_table(get_self(), get_self().value);
+      const auto &drop = airdrops_table.get(id, "airdrop does not exist");
+      check(!drop.closed, "airdrop is closed");
+      check(index < drop.leaves, "invalid leaf index");
+      check(amount.symbol == drop.total.symbol, "symbol precision mismatch");
+      check(amount.amount > 0, "must claim positive quantity");
+
+      airdrop_claims_table claims(get_self(), id);
+      uint64_t word = index / 64;
+      uint64_t bit = uint64_t(1) << (index % 64);
+      auto claims_itr = claims.find(word);
+      check(claims_itr == claims.end() || (claims_itr->bits & bit) == 0, "airdrop already claimed");
+
+      checksum256 leaf = merkle::hash_leaf(id, index, account, amount.amount);
+      check(merkle::verify_proof(leaf, proof, drop.root), "invalid Merkle proof");
+
+      if (claims_itr == claims.end())
+      {
+         claims.emplace(account, [&](auto &c)
+                        {
+            c.word = word;
+            c.bits = bit; });
+      }
+      else
+      {
+         claims.modify(claims_itr, same_payer, [&](auto &c)
+                       { c.bits |= bit; });
+      }
+
+      check(drop.claimed.amount + amount.amount <= drop.total.amount, "claim exceeds the airdrop total");
+      airdrops_table.modify(drop, same_payer, [&](auto &a)
+                            { a.claimed += amount; });
+
+      require_recipient(account);
+      add_balance(account, amount, account);
+   }
+
+   void token::closedrop(uint64_t id)
+   {
+      airdrops airdrops_table(get_self(), get_self().value);
+      const auto &drop = airdrops_table.get(id, "airdrop does not exist");
+      require_auth(drop.issuer);
+      check(!drop.closed, "airdrop is already closed");
+
+      asset unclaimed = drop.total - drop.claimed;
+      airdrops_table.modify(drop, same_payer, [&](auto &a)
+                            { a.closed = true; });
+
+      if (unclaimed.amount > 0)
+      {
+         add_balance(drop.issuer, unclaimed, drop.issuer);
+      }
+   }
+
+   uint64_t token::openchannel(const name &payer, const name &payee, const public_key &key, const asset &quantity, uint32_t timeout_seconds)
+   {
+      require_auth(payer);
+      check(payer != payee, "cannot open a channel to self");
+      check(is_account(payee), "payee account does not exist");
+      check(timeout_seconds > 0, "timeout must be greater than 0");
+
+      auto sym = quantity.symbol.code();
+      stats statstable(get_self(), sym.raw());
+      const auto &st = statstable.get(sym.raw(), "symbol does not exist");
+      check(quantity.is_valid(), "invalid quantity");
+      check(quantity.amount > 0, "must lock positive quantity");
+      check(quantity.symbol == st.supply.symbol, "symbol precision mismatch");
+
+      sub_balance(payer, quantity);
+
+      // Ids come from a counter rather than available_primary_key(), which reuses the id of the highest channel once it is closed
+      channels channels_table(get_self(), get_self().value);
+      channel_state_table channel_state_instance(get_self(), get_self().value);
+      channel_state state = channel_state_instance.get_or_default();
+      uint64_t id = std::max(state.next_id, channels_table.available_primary_key());
+      state.next_id = id + 1;
+      channel_state_instance.set(state, get_self());
+
+      channels_table.emplace(payer, [&](auto &c)
+                             {
+         c.id = id;
+         c.payer = payer;
+         c.payee = payee;
+         c.key = key;
+         c.deposit = quantity;
+         c.settled = asset(0, quantity.symbol);
+         c.expires = time_point_sec(current_time_point()) + timeout_seconds; });
+
+      require_recipient(payee);
+      return id;
+   }
+
+   void token::settle(uint64_t id, const asset &amount, const signature &sig)
+   {
+      channels channels_table(get_self(), get_self().value);
+      const auto &chan = channels_table.get(id, "channel does not exist");
+      require_auth(chan.payee);
+      check(time_point_sec(current_time_point()) < chan.expires, "channel has expired");
+      check(amount.symbol == chan.deposit.symbol, "symbol precision mismatch");
+      check(amount > chan.settled, "voucher is not greater than the settled amount");
+      check(amount <= chan.deposit, "voucher exceeds the channel deposit");
+
+      assert_recover_key(voucher_digest(get_self(), id, chan.payer, chan.payee, chan.key, amount), sig, chan.key);
+
+      name payee = chan.payee;
+      asset payment = amount - chan.settled;
+      if (amount == chan.deposit)
+      {
+         channels_table.erase(chan);
+      }
+      else
+      {
+         channels_table.modify(chan, same_payer, [&](auto &c)
+                               { c.settled = amount; });
+      }
+
+      add_balance(payee, payment, payee);
+   }
+
+   void token::refund(uint64_t id)
+   {
+      channels channels_table(get_self(), get_self().value);
+      const auto &chan = channels_table.get(id, "channel does not exist");
+      require_auth(chan.payer);
+      check(time_point_sec(current_time_point()) >= chan.expires, "channel has not expired");
+
+      name payer = chan.payer;
+      asset unsettled = chan.deposit - chan.settled;
+      channels_table.erase(chan);
+
+      add_balance(payer, unsettled, payer);
+   }
+
+   uint64_t token::newepoch()
+   {
+      // Admin only function
+      require_auth(get_self());
+
+      checkpoint_state_table state_singleton(get_self(), get_self().value);
+      checkpoint_state state = state_singleton.get_or_default();
+      state.epoch++;
+      state.started = time_point_sec(current_time_point());
+      state_singleton.set(state, get_self());
+
+      return state.epoch;
+   }
+
+   asset token::balanceat(const name &account, uint64_t epoch)
+   {
+      checkpoint_state_table state_singleton(get_self(), get_self().value);
+      uint64_t current_epoch = state_singleton.get_or_default().epoch;
+      check(epoch > 0 && epoch <= current_epoch, "epoch has not started");
+      check(epoch + CHECKPOINT_RETENTION_EPOCHS > current_epoch, "epoch is older than the checkpoint retention");
+
+      // Balances not yet migrated from the old symbol count as the new symbol
+      accounts acnts(get_self(), account.value);
+      int64_t current = 0;
+      auto it = acnts.find(SYSTEM_RESOURCE_CURRENCY.code().raw());
+      if (it != acnts.end())
+      {
+         current += it->balance.amount;
+      }
+      auto legacy = acnts.find(SYSTEM_RESOURCE_CURRENCY_OLD.code().raw());
+      if (legacy != acnts.end())
+      {
+         current += legacy->balance.amount;
+      }
+
+      balance_checkpoints checkpoints(get_self(), account.value);
+      return asset(read_checkpoint(checkpoints, epoch, current), SYSTEM_RESOURCE_CURRENCY);
+   }
+
+   asset token::supplyat(uint64_t epoch)
+   {
+      checkpoint_state_table state_singleton(get_self(), get_self().value);
+      uint64_t current_epoch = state_singleton.get_or_default().epoch;
+      check(epoch > 0 && epoch <= current_epoch, "epoch has not started");
+      check(epoch + CHECKPOINT_RETENTION_EPOCHS > current_epoch, "epoch is older than the checkpoint retention");
+
+      supply_checkpoints checkpoints(get_self(), get_self().value);
+      asset supply = get_supply(get_self(), SYSTEM_RESOURCE_CURRENCY.code());
+      return asset(read_checkpoint(checkpoints, epoch, supply.amount), SYSTEM_RESOURCE_CURRENCY);
+   }
+
+   void token::checkpoint_balance(const name &owner, const asset &balance_before, const name &ram_payer)
+   {
+      if (balance_before.symbol != SYSTEM_RESOURCE_CURRENCY)
+      {
+         return;
+      }
+
+      checkpoint_state_table state_singleton(get_self(), get_self().value);
+      uint64_t epoch = state_singleton.get_or_default().epoch;
+      if (epoch == 0)
+      {
+         return;
+      }
+
+      balance_checkpoints checkpoints(get_self(), owner.value);
+      write_checkpoint(checkpoints, ram_payer, epoch, balance_before.amount);
+   }
+
+   void token::checkpoint_supply(const asset &supply_before)
+   {
+      if (supply_before.symbol != SYSTEM_RESOURCE_CURRENCY)
+      {
+         return;
+      }
+
+      checkpoint_state_table state_singleton(get_self(), get_self().value);
+      uint64_t epoch = state_singleton.get_or_default().epoch;
+      if (epoch == 0)
+      {
+         return;
+      }
+
+      supply_checkpoints checkpoints(get_self(), get_self().value);
+      write_checkpoint(checkpoints, get_self(), epoch, supply_before.amount);
+   }
+
+   void token::feedopen(const name &owner, uint8_t capacity)
+   {
+      require_auth(owner);
+      check(capacity > 0 && capacity <= MAX_FEED_CAPACITY, "capacity must be between 1 and 50");
+
+      feed_state_table state_singleton(get_self(), owner.value);
+      check(!state_singleton.exists(), "feed already open");
+
+      // All slots are created now so that transfers only modify rows, which the owner's RAM already covers
+      feed feed_table(get_self(), owner.value);
+      for (uint8_t slot = 0; slot < capacity; slot++)
+      {
+         feed_table.emplace(owner, [&](auto &f)
+                            {
+            f.slot = slot;
+            f.seq = 0;
+            f.quantity = asset(0, SYSTEM_RESOURCE_CURRENCY); });
+      }
+
+      state_singleton.set(feed_state{capacity, 1}, owner);
+   }
+
+   void token::feedclose(const name &owner)
+   {
+      require_auth(owner);
+
+      feed_state_table state_singleton(get_self(), owner.value);
+      check(state_singleton.exists(), "feed is not open");
+      state_singleton.remove();
+
+      feed feed_table(get_self(), owner.value);
+      for (auto itr = feed_table.begin(); itr != feed_table.end();)
+      {
+         itr = feed_table.erase(itr);
+      }
+   }
+
+   void token::append_feed(const name &owner, const name &from, const name &to, const asset &quantity)
+   {
+      feed_state_table state_singleton(get_self(), owner.value);
+      if (!state_singleton.exists())
+      {
+         return;
+      }
+
+      feed_state state = state_singleton.get();
+      feed feed_table(get_self(), owner.value);
+      const auto &entry = feed_table.get(state.next_seq % state.capacity, "feed slot not found");
+      feed_table.modify(entry, same_payer, [&](auto &f)
+                        {
+         f.seq = state.next_seq;
+         f.from = from;
+         f.to = to;
+         f.quantity = quantity;
+         f.time = time_point_sec(current_time_point()); });
+
+      state.next_seq++;
+      state_singleton.set(state, same_payer);
    }
 
    void token::sub_balance(const name &owner, const asset &value)
    {
       accounts from_acnts(get_self(), owner.value);
 
-      const auto &from = from_acnts.get(value.symbol.code().raw(), "no balance object found");
-      check(from.balance.amount >= value.amount, "overdrawn balance");
+      auto from = from_acnts.find(value.symbol.code().raw());
+      // An unmigrated balance in the old symbol is converted in the same write
+      int64_t legacy_amount = 0;
+      bool has_legacy = value.symbol == SYSTEM_RESOURCE_CURRENCY && take_legacy_balance(from_acnts, legacy_amount);
 
-      from_acnts.modify(from, get_self(), [&](auto &a)
-                        { a.balance -= value; });
+      check(from != from_acnts.end() || has_legacy, "no balance object found");
+      int64_t balance = (from != from_acnts.end() ? from->balance.amount : 0) + legacy_amount;
+      check(balance >= value.amount, "overdrawn balance");
+      checkpoint_balance(owner, asset(balance, value.symbol), owner);
+
+      if (from == from_acnts.end())
+      {
+         from_acnts.emplace(get_self(), [&](auto &a)
+                            { a.balance = asset(balance - value.amount, value.symbol); });
+      }
+      else
+      {
+         from_acnts.modify(from, get_self(), [&](auto &a)
+                           { a.balance.amount = balance - value.amount; });
+      }
+      update_holder(owner, asset(balance - value.amount, value.symbol), get_self());
    }
 
    void token::add_balance(const name &owner, const asset &value, const name &ram_payer)
    {
       accounts to_acnts(get_self(), owner.value);
       auto to = to_acnts.find(value.symbol.code().raw());
+      // An unmigrated balance in the old symbol is converted in the same write
+      int64_t legacy_amount = 0;
+      if (value.symbol == SYSTEM_RESOURCE_CURRENCY)
+      {
+         take_legacy_balance(to_acnts, legacy_amount);
+      }
+
+      int64_t balance = (to != to_acnts.end() ? to->balance.amount : 0) + legacy_amount + value.amount;
+      checkpoint_balance(owner, asset(balance - value.amount, value.symbol), ram_payer);
       if (to == to_acnts.end())
       {
          to_acnts.emplace(ram_payer, [&](auto &a)
-                          { a.balance = value; });
+                          { a.balance = asset(balance, value.symbol); });
       }
       else
       {
          to_acnts.modify(to, same_payer, [&](auto &a)
-                         { a.balance += value; });
+                         { a.balance.amount = balance; });
       }
+      update_holder(owner, asset(balance, value.symbol), ram_payer);
+   }
+
+   bool token::take_legacy_balance(accounts &acnts, int64_t &amount)
+   {
+      auto legacy = acnts.find(SYSTEM_RESOURCE_CURRENCY_OLD.code().raw());
+      if (legacy == acnts.end())
+      {
+         return false;
+      }
+
+      // Old balances convert 1:1, both symbols have the same precision
+      amount = legacy->balance.amount;
+      acnts.erase(legacy);
+      return true;
    }
 
    void token::open(const name &owner, const symbol &symbol, const name &ram_payer)
@@ -143,6 +582,7 @@ namespace eosio
       {
          acnts.emplace(ram_payer, [&](auto &a)
                        { a.balance = asset{0, symbol}; });
+         update_holder(owner, asset{0, symbol}, ram_payer);
       }
    }
 
@@ -154,6 +594,99 @@ namespace eosio
       check(it != acnts.end(), "Balance row already deleted or never existed. Action won't have any effect.");
       check(it->balance.amount == 0, "Cannot close because the balance is not zero.");
       acnts.erase(it);
+      if (symbol == SYSTEM_RESOURCE_CURRENCY)
+      {
+         remove_holder(owner);
+      }
+   }
+
+   void token::update_holder(const name &owner, const asset &balance, const name &ram_payer)
+   {
+      // Only the system currency is indexed
+      if (balance.symbol != SYSTEM_RESOURCE_CURRENCY)
+      {
+         return;
+      }
+
+      holders holders_table(get_self(), get_self().value);
+      auto itr = holders_table.find(owner.value);
+      bool was_holder = itr != holders_table.end();
+      bool was_nonzero = was_holder && itr->balance > 0;
+
+      if (!was_holder)
+      {
+         holders_table.emplace(ram_payer, [&](auto &h)
+                               {
+            h.account = owner;
+            h.balance = balance.amount; });
+      }
+      else if (itr->balance != balance.amount)
+      {
+         holders_table.modify(itr, same_payer, [&](auto &h)
+                              { h.balance = balance.amount; });
+      }
+
+      // The counters are only written when they change, not on every transfer
+      bool is_nonzero = balance.amount > 0;
+      if (!was_holder || was_nonzero != is_nonzero)
+      {
+         holder_stats_table stats_singleton(get_self(), get_self().value);
+         holder_stats counters = stats_singleton.get_or_default();
+         if (!was_holder)
+         {
+            counters.holders++;
+         }
+         if (is_nonzero && !was_nonzero)
+         {
+            counters.nonzero++;
+         }
+         else if (was_nonzero && !is_nonzero)
+         {
+            counters.nonzero--;
+         }
+         stats_singleton.set(counters, get_self());
+      }
+   }
+
+   void token::remove_holder(const name &owner)
+   {
+      holders holders_table(get_self(), get_self().value);
+      auto itr = holders_table.find(owner.value);
+      if (itr == holders_table.end())
+      {
+         return;
+      }
+
+      holder_stats_table stats_singleton(get_self(), get_self().value);
+      holder_stats counters = stats_singleton.get_or_default();
+      counters.holders--;
+      if (itr->balance > 0)
+      {
+         counters.nonzero--;
+      }
+      stats_singleton.set(counters, get_self());
+
+      holders_table.erase(itr);
+   }
+
+   void token::syncholders(const std::vector<name> &accounts_to_sync)
+   {
+      // Admin only function
+      require_auth(get_self());
+
+      for (const name &owner : accounts_to_sync)
+      {
+         accounts acnts(get_self(), owner.value);
+         auto it = acnts.find(SYSTEM_RESOURCE_CURRENCY.code().raw());
+         if (it == acnts.end())
+         {
+            remove_holder(owner);
+         }
+         else
+         {
+            update_holder(owner, it->balance, get_self());
+         }
+      }
    }
 
    void token::migratestats()
@@ -197,15 +730,91 @@ namespace eosio
       // Admin only function
       require_auth(get_self());
 
+      migrate_balance(account);
+   }
+
+   uint32_t token::migrate_balance(const name &account)
+   {
       accounts account_balance(get_self(), account.value);
 
-      auto balance_itr = account_balance.find(SYSTEM_RESOURCE_CURRENCY_OLD.code().raw());
-      
-      if (balance_itr != account_balance.end()) {
-         account_balance.emplace(get_self(), [&](auto &a) {
-            a.balance = asset(balance_itr->balance.amount, SYSTEM_RESOURCE_CURRENCY);
-         });
-         account_balance.erase(balance_itr);
+      int64_t amount = 0;
+      if (!take_legacy_balance(account_balance, amount))
+      {
+         return 0;
+      }
+
+      auto new_itr = account_balance.find(SYSTEM_RESOURCE_CURRENCY.code().raw());
+      if (new_itr == account_balance.end())
+      {
+         account_balance.emplace(get_self(), [&](auto &a)
+                                 { a.balance = asset(amount, SYSTEM_RESOURCE_CURRENCY); });
       }
+      else
+      {
+         account_balance.modify(new_itr, same_payer, [&](auto &a)
+                                { a.balance.amount += amount; });
+         amount = new_itr->balance.amount;
+      }
+      update_holder(account, asset(amount, SYSTEM_RESOURCE_CURRENCY), get_self());
+      return 1;
+   }
+
+   void token::regscopes(const std::vector<name> &scopes)
+   {
+      // Admin only function
+      require_auth(get_self());
+
+      migration_scopes scopes_table(get_self(), get_self().value);
+      migration_table migration_singleton(get_self(), get_self().value);
+      migration_state state = migration_singleton.get_or_default();
+
+      for (const name &scope : scopes)
+      {
+         if (scopes_table.find(scope.value) != scopes_table.end())
+         {
+            continue;
+         }
+         scopes_table.emplace(get_self(), [&](auto &s)
+                              { s.scope = scope; });
+
+         // Make sure the next migrate call visits the new scope
+         if (state.complete)
+         {
+            state.cursor = scope.value;
+            state.complete = false;
+         }
+         else if (scope.value < state.cursor)
+         {
+            state.cursor = scope.value;
+         }
+      }
+
+      migration_singleton.set(state, get_self());
+   }
+
+   bool token::migrate(uint32_t batch_size)
+   {
+      // Admin only function
+      require_auth(get_self());
+      check(batch_size > 0 && batch_size <= MAX_MIGRATE_BATCH_SIZE, "batch_size must be between 1 and " + std::to_string(MAX_MIGRATE_BATCH_SIZE));
+
+      migration_table migration_singleton(get_self(), get_self().value);
+      migration_state state = migration_singleton.get_or_default();
+      if (state.complete)
+      {
+         return true;
+      }
+
+      // Each scope holds at most one legacy balance, so it always fits in the remaining budget of at least one row
+      migration_scopes scopes_table(get_self(), get_self().value);
+      scope_migration::migration_result result = scope_migration::migrate(scopes_table, state.cursor, batch_size, [&](const name &scope, uint32_t)
+                                                                          { return scope_migration::scope_result{migrate_balance(scope), true}; });
+
+      state.cursor = result.cursor;
+      state.migrated += result.rows;
+      state.complete = result.complete;
+      migration_singleton.set(state, get_self());
+
+      return state.complete;
    }
 } /// namespace eosio
\ No newline at end of file
@@ -7,4 +7,7 @@ cd "${PARENT_PATH}"
 
 source ../compile_contract.sh
 
+mkdir -p "${PARENT_PATH}/include/common"
+cp "${PARENT_PATH}/../common/include/common/merkle.hpp" "${PARENT_PATH}/include/common/merkle.hpp"
+
 compile_contract "${PARENT_PATH}" "staking.tmy" "${BUILD_METHOD}"
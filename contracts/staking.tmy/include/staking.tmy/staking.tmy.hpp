@@ -9,11 +9,13 @@
 #include <eosio/asset.hpp>
 #include <eosio/system.hpp>
 #include <eosio/singleton.hpp>
+#include <common/merkle.hpp>
 
 namespace stakingtoken
 {
     using eosio::action_wrapper;
     using eosio::asset;
+    using eosio::checksum256;
     using eosio::check;
     using eosio::days;
     using eosio::microseconds;
@@ -63,6 +65,8 @@ namespace stakingtoken
         const double MICROSECONDS_PER_YEAR = 365.25 * 24 * 60 * 60 * 1000000;
         static constexpr uint64_t LOWEST_PERSON_NAME  = ("p1111111111"_n).value;
         static constexpr uint64_t HIGHEST_PERSON_NAME  = ("pzzzzzzzzzz"_n).value;    
+        // Maximum depth of a yield Merkle tree, enough for 2^32 stakers
+        static constexpr uint8_t MAX_PROOF_LENGTH = 32;
 
         stakingToken(name receiver, name code, eosio::datastream<const char *> ds)
           : contract(receiver, code, ds),
@@ -108,6 +112,56 @@ namespace stakingtoken
          */
         [[eosio::action]] void cron();
 
+        /**
+         * Recounts the stakers and allocations of one cron interval bucket
+         * Used to initialise the bucket counters for stakers that existed before they were tracked
+         *
+         * @param interval - the cron interval to recount
+         */
+        [[eosio::action]] void syncbucket(uint8_t interval);
+
+        /**
+         * Sets how staking yield is distributed
+         * Switching to Cron mode starts compounding from now, as the yield before was paid by the epoch roots
+         *
+         * @param mode - 0 (Cron) the cron job iterates over stakers, 1 (Merkle) stakers claim yield with a proof against a root set with setyieldroot
+         */
+        [[eosio::action]] void setdistmode(uint8_t mode);
+
+        /**
+         * Publishes the Merkle root of the staking yield of an epoch, computed off-chain
+         * Only allowed in Merkle mode
+         *
+         * @details The total is reserved from the current yield pool. Each leaf is
+         * merkle::hash_leaf(epoch, index, staker, amount) with amount as the int64 token amount.
+         *
+         * @param epoch - the ID of the yield epoch
+         * @param root - the Merkle root of the yield of each staker
+         * @param total - the sum of the yield of all leaves
+         * @param leaves - the number of leaves in the tree
+         */
+        [[eosio::action]] void setyieldroot(uint64_t epoch, checksum256 root, asset total, uint64_t leaves);
+
+        /**
+         * Claims the staking yield of a staker for an epoch
+         * Can be called by the staker or by a relayer on their behalf, the yield is always sent to the staker
+         * Only allowed in Merkle mode. The staker's last_payout is not changed, as cron relies on it
+         *
+         * @param staker - the account name of the staker
+         * @param epoch - the ID of the yield epoch
+         * @param index - the index of the staker's leaf in the tree
+         * @param amount - the yield of the staker
+         * @param proof - the sibling hashes from the leaf up to the root
+         */
+        [[eosio::action]] void claimyield(name staker, uint64_t epoch, uint64_t index, asset amount, std::vector<checksum256> proof);
+
+        /**
+         * Closes a yield epoch and returns the unclaimed yield to the yield pool
+         *
+         * @param epoch - the ID of the yield epoch
+         */
+        [[eosio::action]] void closeepoch(uint64_t epoch);
+
         #ifdef BUILD_TEST
         /**
          * Resets all the contract data
@@ -158,6 +212,79 @@ namespace stakingtoken
         // Define the mapping of staking accounts
         typedef eosio::multi_index<"stakingaccou"_n, staking_account> staking_accounts;
 
+        // Per cron interval counts of the rows that cron() iterates over
+        struct [[eosio::table]] cron_bucket
+        {
+          uint8_t interval; // The cron interval that the stakers in this bucket are processed in
+          uint32_t stakers; // The number of staking accounts in the bucket
+          uint32_t allocations; // The number of staking allocations of all stakers in the bucket
+          uint32_t releasing; // The number of those allocations that have requested to unstake
+          uint64_t primary_key() const { return interval; }
+          EOSLIB_SERIALIZE(struct cron_bucket, (interval)(stakers)(allocations)(releasing))
+        };
+        typedef eosio::multi_index<"cronbuckets"_n, cron_bucket> cron_buckets;
+
+        enum enum_distribution_mode
+        {
+          Cron_Distribution,
+          Merkle_Distribution
+        };
+
+        struct [[eosio::table]] distribution_config
+        {
+          uint8_t mode; // How staking yield is distributed, see enum_distribution_mode
+          eosio::time_point cron_start; // When the mode last changed to Cron, cron does not compound yield from before it
+          EOSLIB_SERIALIZE(distribution_config, (mode)(cron_start))
+        };
+        typedef eosio::singleton<"distconfig"_n, distribution_config> distribution_config_table;
+        // Following line needed to correctly generate ABI. See https://github.com/EOSIO/eosio.cdt/issues/280#issuecomment-439666574
+        typedef eosio::multi_index<"distconfig"_n, distribution_config> distribution_config_table_dump;
+
+        struct [[eosio::table]] yield_epoch
+        {
+          uint64_t epoch; // The ID of the yield epoch
+          checksum256 root; // The Merkle root of the yield of each staker
+          eosio::asset total; // The yield reserved from the yield pool for this epoch
+          eosio::asset claimed; // The yield claimed so far
+          uint64_t leaves; // The number of leaves in the tree
+          bool closed; // Whether the unclaimed yield has been returned to the yield pool
+          uint64_t primary_key() const { return epoch; }
+          EOSLIB_SERIALIZE(struct yield_epoch, (epoch)(root)(total)(claimed)(leaves)(closed))
+        };
+        typedef eosio::multi_index<"yieldepochs"_n, yield_epoch> yield_epochs;
+
+        // Bitmap of the claimed leaves of an epoch, scoped by epoch. Each row holds 64 leaves.
+        struct [[eosio::table]] yield_claims
+        {
+          uint64_t word; // The leaf index divided by 64
+          uint64_t bits; // Bit (index % 64) is set if the leaf has been claimed
+          uint64_t primary_key() const { return word; }
+          EOSLIB_SERIALIZE(struct yield_claims, (word)(bits))
+        };
+        typedef eosio::multi_index<"yieldclaims"_n, yield_claims> yield_claims_table;
+
+        // The expected workload of one upcoming cron() call
+        struct cron_plan
+        {
+          uint8_t interval; // The cron interval that will be processed
+          eosio::time_point start_time; // The time that the cron interval starts
+          uint32_t stakers; // The number of staking accounts that will be processed
+          uint32_t allocations; // The number of staking allocations that will be processed
+          uint32_t releasing; // The number of those allocations that are unstaking
+          uint32_t expected_rows; // The number of table rows that will be read
+          uint32_t expected_modifications; // The maximum number of table writes and inline transfers
+          EOSLIB_SERIALIZE(struct cron_plan, (interval)(start_time)(stakers)(allocations)(releasing)(expected_rows)(expected_modifications))
+        };
+
+        /**
+         * Returns the expected workload of the next cron() calls, for the current distribution mode
+         * Read-only action
+         *
+         * @param count - the number of upcoming cron intervals to plan, starting with the current one
+         * @returns the expected workload of each interval
+         */
+        [[eosio::action, eosio::read_only]] std::vector<cron_plan> plancron(uint8_t count);
+
         using staketokens_action = action_wrapper<"staketokens"_n, &stakingToken::staketokens>;
         using requnstake_action = action_wrapper<"requnstake"_n, &stakingToken::requnstake>;
         using releasetoken_action = action_wrapper<"releasetoken"_n, &stakingToken::releasetoken>;
@@ -167,9 +294,17 @@ namespace stakingtoken
         settings_table settings_table_instance;
 
         /**
-         * Add yield to an account
+         * Add yield to an account and release its matured unstakes
+         *
+         * @param distribution - in Merkle mode only the matured unstakes are released, in Cron mode yield
+         * is compounded from the later of the last payout and distribution.cron_start
          */
-        void create_account_yield(time_point now, const name &staker, double apy, staking_settings &settings, staking_accounts::const_iterator accounts_itr);
+        void create_account_yield(time_point now, const name &staker, double apy, staking_settings &settings, staking_accounts::const_iterator accounts_itr, const distribution_config &distribution);
+
+        /**
+         * Returns the distribution config, Cron mode if it has not been set
+         */
+        distribution_config get_distribution_config();
       
         /**
          * Check minimum amount needed to prevent DOSing the action
@@ -180,5 +315,20 @@ namespace stakingtoken
           *  Releases staked tokens back to the staker.
         */
         void _releasetoken(const name &staker, staking_settings &settings, staking_allocations &staking_allocations_table, staking_allocations::const_iterator allocation);
+
+        /**
+         * Returns the cron interval that a staker is processed in
+         */
+        uint8_t get_cron_interval(const name &staker);
+
+        /**
+         * Returns the range of staker account names that are processed in a cron interval
+         */
+        void get_cron_interval_range(uint8_t interval, uint64_t &lower_bound, uint64_t &upper_bound);
+
+        /**
+         * Adds to the counters of the cron interval bucket of a staker
+         */
+        void update_cron_bucket(const name &staker, int32_t stakers, int32_t allocations, int32_t releasing);
     };
 }
\ No newline at end of file
@@ -81,7 +81,8 @@ namespace stakingtoken
 
       // Add the user to the accounts table if they are not already there
       auto itr = staking_accounts_table.find(staker.value);
-      if (itr == staking_accounts_table.end())
+      bool new_staker = itr == staking_accounts_table.end();
+      if (new_staker)
       {
          staking_accounts_table.emplace(get_self(), [&](auto &row)
          {
@@ -92,6 +93,7 @@ namespace stakingtoken
             row.version = 1;
          });
       }
+      update_cron_bucket(staker, new_staker ? 1 : 0, 1, 0);
 
       // Update the total staked amount
       staking_settings settings = settings_table_instance.get();
@@ -130,6 +132,8 @@ namespace stakingtoken
       settings.total_staked -= itr->tokens_staked;
       settings.total_releasing += itr->tokens_staked;
       settings_table_instance.set(settings, get_self());
+
+      update_cron_bucket(staker, 0, 0, 1);
    }
 
    void stakingToken::_releasetoken(const name &staker, staking_settings &settings, staking_allocations &staking_allocations_table, staking_allocations::const_iterator allocation)
@@ -138,6 +142,7 @@ namespace stakingtoken
       settings_table_instance.set(settings, get_self());
 
       staking_allocations_table.erase(allocation);
+      update_cron_bucket(staker, 0, -1, -1);
 
       // Transfer tokens back to the staker
       eosio::action(
@@ -179,6 +184,10 @@ namespace stakingtoken
          require_auth(get_self());
       }
 
+      // In Merkle mode yield is claimed with claimyield() instead, so cron only releases matured unstakes
+      distribution_config distribution = get_distribution_config();
+      bool compound_yield = distribution.mode != Merkle_Distribution;
+
       staking_settings settings = settings_table_instance.get();
 
       // Calculate the yield rate for the interval
@@ -192,9 +201,8 @@ namespace stakingtoken
       uint8_t current_cron_interval = (now.time_since_epoch().count() % STAKING_CYCLE_MICROSECONDS) / CRON_PERIOD_MICROSECONDS;
 
       // Calculate the range of account names for this interval
-      uint64_t range_size = (HIGHEST_PERSON_NAME - LOWEST_PERSON_NAME) / cron_intervals;
-      uint64_t lower_bound = LOWEST_PERSON_NAME + (current_cron_interval * range_size);
-      uint64_t upper_bound = (current_cron_interval == (cron_intervals-1)) ? HIGHEST_PERSON_NAME + 1 : (lower_bound + range_size);
+      uint64_t lower_bound, upper_bound;
+      get_cron_interval_range(current_cron_interval, lower_bound, upper_bound);
 
       eosio::print("{\"event_log\":{\"account\":\"staking.tmy\",\"action\":\"cron\"},\"time\":\"", now.to_string(),
          "Z\",\"events\":[");
@@ -210,10 +218,11 @@ namespace stakingtoken
       while (itr != staking_accounts_table.end() && itr->staker.value < upper_bound)
       {
          // check did not call create_account_yield() since before the last cron period
-         // If so then this batch of accounts has already been processed in this interval, so exit
-         if (itr->last_payout + microseconds(1.01 * CRON_PERIOD_MICROSECONDS) > now) return;
+         // In Merkle mode last_payout is not updated, and releasing is safe to repeat, so do not exit
+         // In Merkle mode last_payout is set by claimyield(), and releasing is safe to repeat, so do not exit
+         if (compound_yield && itr->last_payout + microseconds(1.01 * CRON_PERIOD_MICROSECONDS) > now) return;
 
-         create_account_yield(now, itr->staker, apy, settings, itr);
+         create_account_yield(now, itr->staker, apy, settings, itr, distribution);
          count++;
          itr++;
       }
@@ -221,9 +230,280 @@ namespace stakingtoken
       eosio::print("]}");
    }
 
-   void stakingToken::create_account_yield(time_point now, const name &staker, double apy, staking_settings &settings, staking_accounts::const_iterator accounts_itr)
+   void stakingToken::setdistmode(uint8_t mode)
+   {
+      require_auth(get_self());
+      check(mode == Cron_Distribution || mode == Merkle_Distribution, "Invalid distribution mode");
+
+      distribution_config config = get_distribution_config();
+      if (mode == Cron_Distribution && config.mode != Cron_Distribution)
+      {
+         // The epoch roots paid the yield up to now, and last_payout was not moved while in Merkle mode
+         config.cron_start = eosio::current_time_point();
+      }
+      config.mode = mode;
+
+      distribution_config_table distribution_config_instance(get_self(), get_self().value);
+      distribution_config_instance.set(config, get_self());
+   }
+
+   stakingToken::distribution_config stakingToken::get_distribution_config()
+   {
+      distribution_config_table distribution_config_instance(get_self(), get_self().value);
+      return distribution_config_instance.get_or_default({Cron_Distribution, time_point()});
+   }
+
+   void stakingToken::setyieldroot(uint64_t epoch, checksum256 root, asset total, uint64_t leaves)
+   {
+      require_auth(get_self());
+      check(get_distribution_config().mode == Merkle_Distribution, "Yield roots can only be set in Merkle mode");
+      check_asset(total);
+      check(leaves > 0, "Leaves must be greater than 0");
+
+      yield_epochs yield_epochs_table(get_self(), get_self().value);
+      check(yield_epochs_table.find(epoch) == yield_epochs_table.end(), "Yield epoch already exists");
+
+      // Reserve the yield of the epoch so that all claims can be paid
+      staking_settings settings = settings_table_instance.get();
+      check(settings.current_yield_pool >= total, "Not enough tokens in the yield pool");
+      settings.current_yield_pool -= total;
+      settings_table_instance.set(settings, get_self());
+
+      yield_epochs_table.emplace(get_self(), [&](auto &row)
+      {
+         row.epoch = epoch;
+         row.root = root;
+         row.total = total;
+         row.claimed = asset(0, SYSTEM_RESOURCE_CURRENCY);
+         row.leaves = leaves;
+         row.closed = false;
+      });
+   }
+
+   void stakingToken::claimyield(name staker, uint64_t epoch, uint64_t index, asset amount, std::vector<checksum256> proof)
+   {
+      // No auth required, the yield can only be sent to the staker in the leaf
+      check(get_distribution_config().mode == Merkle_Distribution, "Yield can only be claimed in Merkle mode");
+      check_asset(amount);
+      check(proof.size() <= MAX_PROOF_LENGTH, "Proof is too long");
+
+      yield_epochs yield_epochs_table(get_self(), get_self().value);
+      auto epoch_itr = yield_epochs_table.find(epoch);
+      check(epoch_itr != yield_epochs_table.end(), "Yield epoch not found");
+      check(!epoch_itr->closed, "Yield epoch is closed");
+      check(index < epoch_itr->leaves, "Invalid leaf index");
+
+      yield_claims_table yield_claims(get_self(), epoch);
+      uint64_t word = index / 64;
+      uint64_t bit = uint64_t(1) << (index % 64);
+      auto claims_itr = yield_claims.find(word);
+      check(claims_itr == yield_claims.end() || (claims_itr->bits & bit) == 0, "Yield already claimed");
+
+      checksum256 leaf = merkle::hash_leaf(epoch, index, staker, amount.amount);
+      check(merkle::verify_proof(leaf, proof, epoch_itr->root), "Invalid Merkle proof");
+
+      if (claims_itr == yield_claims.end())
+      {
+         yield_claims.emplace(get_self(), [&](auto &row)
+         {
+            row.word = word;
+            row.bits = bit;
+         });
+      }
+      else
+      {
+         yield_claims.modify(claims_itr, eosio::same_payer, [&](auto &row)
+         {
+            row.bits |= bit;
+         });
+      }
+
+      check(epoch_itr->claimed + amount <= epoch_itr->total, "Claim exceeds the epoch total");
+      yield_epochs_table.modify(epoch_itr, eosio::same_payer, [&](auto &row)
+      {
+         row.claimed += amount;
+      });
+
+      // last_payout is left to cron, which orders its early exit and compounds from it
+      auto account_itr = staking_accounts_table.find(staker.value);
+      if (account_itr != staking_accounts_table.end())
+      {
+         staking_accounts_table.modify(account_itr, eosio::same_payer, [&](auto &row)
+         {
+            row.total_yield += amount;
+            row.payments += 1;
+         });
+      }
+
+      require_recipient(staker);
+
+      eosio::action(
+         {get_self(), "active"_n},
+         TOKEN_CONTRACT,
+         "transfer"_n,
+         std::make_tuple(get_self(), staker, amount, std::string("staking yield")))
+         .send();
+   }
+
+   void stakingToken::closeepoch(uint64_t epoch)
+   {
+      require_auth(get_self());
+
+      yield_epochs yield_epochs_table(get_self(), get_self().value);
+      auto epoch_itr = yield_epochs_table.find(epoch);
+      check(epoch_itr != yield_epochs_table.end(), "Yield epoch not found");
+      check(!epoch_itr->closed, "Yield epoch is already closed");
+
+      staking_settings settings = settings_table_instance.get();
+      settings.current_yield_pool += epoch_itr->total - epoch_itr->claimed;
+      settings_table_instance.set(settings, get_self());
+
+      yield_epochs_table.modify(epoch_itr, eosio::same_payer, [&](auto &row)
+      {
+         row.closed = true;
+      });
+   }
+
+   uint8_t stakingToken::get_cron_interval(const name &staker)
+   {
+      uint64_t range_size = (HIGHEST_PERSON_NAME - LOWEST_PERSON_NAME) / cron_intervals;
+      uint64_t interval = (staker.value - LOWEST_PERSON_NAME) / range_size;
+
+      // The last interval also includes the remainder of the range
+      return std::min(interval, static_cast<uint64_t>(cron_intervals - 1));
+   }
+
+   void stakingToken::get_cron_interval_range(uint8_t interval, uint64_t &lower_bound, uint64_t &upper_bound)
    {
-      microseconds since_last_payout = now - accounts_itr->last_payout;
+      uint64_t range_size = (HIGHEST_PERSON_NAME - LOWEST_PERSON_NAME) / cron_intervals;
+      lower_bound = LOWEST_PERSON_NAME + (interval * range_size);
+      upper_bound = (interval == (cron_intervals-1)) ? HIGHEST_PERSON_NAME + 1 : (lower_bound + range_size);
+   }
+
+   void stakingToken::update_cron_bucket(const name &staker, int32_t stakers, int32_t allocations, int32_t releasing)
+   {
+      cron_buckets cron_buckets_table(get_self(), get_self().value);
+      uint8_t interval = get_cron_interval(staker);
+
+      auto itr = cron_buckets_table.find(interval);
+      if (itr == cron_buckets_table.end())
+      {
+         cron_buckets_table.emplace(get_self(), [&](auto &row)
+         {
+            row.interval = interval;
+            row.stakers = std::max(stakers, 0);
+            row.allocations = std::max(allocations, 0);
+            row.releasing = std::max(releasing, 0);
+         });
+      }
+      else
+      {
+         // Buckets that were not yet synced with syncbucket() may undercount, so never wrap below 0
+         cron_buckets_table.modify(itr, eosio::same_payer, [&](auto &row)
+         {
+            row.stakers = std::max(static_cast<int64_t>(row.stakers) + stakers, int64_t(0));
+            row.allocations = std::max(static_cast<int64_t>(row.allocations) + allocations, int64_t(0));
+            row.releasing = std::max(static_cast<int64_t>(row.releasing) + releasing, int64_t(0));
+         });
+      }
+   }
+
+   void stakingToken::syncbucket(uint8_t interval)
+   {
+      require_auth(get_self());
+      check(interval < cron_intervals, "Invalid cron interval");
+
+      uint64_t lower_bound, upper_bound;
+      get_cron_interval_range(interval, lower_bound, upper_bound);
+
+      uint32_t stakers = 0;
+      uint32_t allocations = 0;
+      uint32_t releasing = 0;
+      for (auto itr = staking_accounts_table.lower_bound(lower_bound); itr != staking_accounts_table.end() && itr->staker.value < upper_bound; itr++)
+      {
+         stakers++;
+         staking_allocations staking_allocations_table(get_self(), itr->staker.value);
+         for (auto allocation_itr = staking_allocations_table.begin(); allocation_itr != staking_allocations_table.end(); allocation_itr++)
+         {
+            allocations++;
+            if (allocation_itr->unstake_requested) releasing++;
+         }
+      }
+
+      cron_buckets cron_buckets_table(get_self(), get_self().value);
+      auto itr = cron_buckets_table.find(interval);
+      if (itr == cron_buckets_table.end())
+      {
+         cron_buckets_table.emplace(get_self(), [&](auto &row)
+         {
+            row.interval = interval;
+            row.stakers = stakers;
+            row.allocations = allocations;
+            row.releasing = releasing;
+         });
+      }
+      else
+      {
+         cron_buckets_table.modify(itr, eosio::same_payer, [&](auto &row)
+         {
+            row.stakers = stakers;
+            row.allocations = allocations;
+            row.releasing = releasing;
+         });
+      }
+   }
+
+   std::vector<stakingToken::cron_plan> stakingToken::plancron(uint8_t count)
+   {
+      check(count > 0 && count <= cron_intervals, "Count must be between 1 and the number of cron intervals");
+
+      const time_point now = eosio::current_time_point();
+      const int64_t now_count = now.time_since_epoch().count();
+      uint8_t current_cron_interval = (now_count % STAKING_CYCLE_MICROSECONDS) / CRON_PERIOD_MICROSECONDS;
+      int64_t current_period_start = now_count - (now_count % CRON_PERIOD_MICROSECONDS);
+
+      // In Merkle mode cron only releases matured unstakes and does not compound yield
+      bool compound_yield = get_distribution_config().mode != Merkle_Distribution;
+
+      cron_buckets cron_buckets_table(get_self(), get_self().value);
+      std::vector<cron_plan> plans;
+      plans.reserve(count);
+
+      for (uint8_t i = 0; i < count; i++)
+      {
+         cron_plan plan{};
+         plan.interval = (current_cron_interval + i) % cron_intervals;
+         plan.start_time = time_point(microseconds(current_period_start + i * CRON_PERIOD_MICROSECONDS));
+
+         auto itr = cron_buckets_table.find(plan.interval);
+         if (itr != cron_buckets_table.end())
+         {
+            plan.stakers = itr->stakers;
+            plan.allocations = itr->allocations;
+            plan.releasing = itr->releasing;
+         }
+
+         // Each staker reads its account row and every allocation row
+         plan.expected_rows = plan.stakers + plan.allocations;
+         // Each releasing allocation is erased, modifies the settings and sends a transfer.
+         // In Cron mode each staker also modifies its account row and the settings, and each staked allocation is modified
+         plan.expected_modifications = 3 * plan.releasing;
+         if (compound_yield)
+         {
+            uint32_t staked = plan.allocations > plan.releasing ? plan.allocations - plan.releasing : 0;
+            plan.expected_modifications += 2 * plan.stakers + staked;
+         }
+
+         plans.push_back(plan);
+      }
+
+      return plans;
+   }
+
+   void stakingToken::create_account_yield(time_point now, const name &staker, double apy, staking_settings &settings, staking_accounts::const_iterator accounts_itr, const distribution_config &distribution)
+   {
+      bool compound_yield = distribution.mode != Merkle_Distribution;
+      microseconds since_last_payout = now - std::max(accounts_itr->last_payout, distribution.cron_start);
       double interval_percentage_yield = std::pow(1 + apy, static_cast<double>(since_last_payout.count()) / MICROSECONDS_PER_YEAR) - 1;
       asset total_yield = asset(0, SYSTEM_RESOURCE_CURRENCY);
 
@@ -236,6 +516,12 @@ namespace stakingtoken
       {
          if (!itr->unstake_requested)
          {
+            if (!compound_yield)
+            {
+               ++itr;
+               continue;
+            }
+
             asset yield = asset(static_cast<int64_t>(itr->tokens_staked.amount * interval_percentage_yield), SYSTEM_RESOURCE_CURRENCY);
       
             staking_allocations_table.modify(itr, eosio::same_payer, [&](auto &row)
@@ -297,6 +583,37 @@ namespace stakingtoken
          account_itr = staking_accounts_table.erase(account_itr);
       }
 
+      yield_epochs yield_epochs_table(get_self(), get_self().value);
+      auto epoch_itr = yield_epochs_table.begin();
+      while (epoch_itr != yield_epochs_table.end())
+      {
+         yield_claims_table yield_claims(get_self(), epoch_itr->epoch);
+         auto claims_itr = yield_claims.begin();
+         while (claims_itr != yield_claims.end())
+         {
+            claims_itr = yield_claims.erase(claims_itr);
+         }
+
+         // Unclaimed yield is reserved outside of the yield pool
+         if (settings_table_instance.exists() && !epoch_itr->closed)
+         {
+            staking_settings settings = settings_table_instance.get();
+            settings.current_yield_pool += epoch_itr->total - epoch_itr->claimed;
+            settings_table_instance.set(settings, get_self());
+         }
+         epoch_itr = yield_epochs_table.erase(epoch_itr);
+      }
+
+      distribution_config_table distribution_config_instance(get_self(), get_self().value);
+      distribution_config_instance.remove();
+
+      cron_buckets cron_buckets_table(get_self(), get_self().value);
+      auto bucket_itr = cron_buckets_table.begin();
+      while (bucket_itr != cron_buckets_table.end())
+      {
+         bucket_itr = cron_buckets_table.erase(bucket_itr);
+      }
+
       if (settings_table_instance.exists()) {
          // send all tokens back to infra.tmy
          staking_settings settings = settings_table_instance.get();
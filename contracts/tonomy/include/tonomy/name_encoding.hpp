@@ -0,0 +1,40 @@
+#pragma once
+
+// Account name generation on the 64 bit name encoding, without any eosio dependency so it can also be built natively
+
+#include <cstdint>
+
+namespace tonomysystem
+{
+   // Number of 5 bit characters in a generated account name. The 13th character of a name only has 4 bits and is left empty.
+   static constexpr int generated_name_length = 12;
+
+   /**
+    * Turns a random number into the value of a 12 character account name
+    *
+    * @details Works on the 5 bit characters of the name encoding, the first character is at the top of the 64 bits.
+    * The first character is set to first_symbol and each empty '.' character is replaced with
+    * a character from '1' to 'z', so the name always has 12 characters.
+    *
+    * @param value - the random number
+    * @param random_number - used to choose the characters that replace empty characters
+    * @param first_symbol - the 5 bit value of the first character
+    */
+   constexpr uint64_t tidy_name_value(uint64_t value, const uint8_t random_number, uint64_t first_symbol)
+   {
+      uint64_t result = 0;
+      for (int i = 0; i < generated_name_length; i++)
+      {
+         int shift = 64 - 5 * (i + 1);
+         uint64_t symbol = i == 0 ? first_symbol : (value >> shift) & 0x1F;
+
+         // Replace any . character (0) with one of the 31 other characters
+         if (symbol == 0)
+         {
+            symbol = (random_number * i) % 31 + 1;
+         }
+         result |= symbol << shift;
+      }
+      return result;
+   }
+}
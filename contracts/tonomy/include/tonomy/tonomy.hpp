@@ -79,6 +79,33 @@ namespace tonomysystem
        */
       tonomy(name receiver, name code, eosio::datastream<const char *> ds);
 
+      static constexpr size_t max_new_people = 100;
+      static constexpr uint8_t app_metadata_version = 1;
+      static constexpr size_t max_app_name_length = 64;
+      static constexpr size_t max_app_description_length = 512;
+      static constexpr size_t max_app_logo_url_length = 256;
+      static constexpr size_t max_app_extension_length = 256;
+
+      // Details of an app, replacing the JSON string of appsv2
+      struct app_metadata
+      {
+         uint8_t version;              // app_metadata_version when written
+         string name;                  // at most max_app_name_length bytes
+         string description;           // at most max_app_description_length bytes
+         string logo_url;              // at most max_app_logo_url_length bytes
+         uint32_t background_color;    // 0xRRGGBB
+         uint32_t accent_color;        // 0xRRGGBB
+         checksum256 content_hash;     // sha256 of larger off-chain content of the app, zero if none
+         std::vector<char> extension;  // fields added in later versions, at most max_app_extension_length bytes
+      };
+
+      // The details of an app in appsv2, converted off-chain from its JSON string
+      struct app_migration
+      {
+         name account_name;
+         app_metadata metadata;
+      };
+
       /**
        * Create a new account for a person
        *
@@ -92,29 +119,48 @@ namespace tonomysystem
           checksum256 username_hash,
           public_key password_key,
           checksum256 password_salt);
+
+      // The details of a person created by newpeople, see newperson
+      struct new_person
+      {
+         checksum256 username_hash;
+         public_key password_key;
+         checksum256 password_salt;
+      };
+
+      /**
+       * Create new accounts for many people in one transaction
+       *
+       * @details All the usernames are checked before any account is created, a failure reports the index of the entry.
+       *
+       * @param people - the username hash, password key and password salt of each person, at most max_new_people
+       */
+      [[eosio::action]] void newpeople(std::vector<new_person> people);
          /**
             * Manually sets the details of an app (admin only)
+            * The metadata record replaced the json_data string parameter, so callers built against the old ABI must be updated
             *
             * @param account_name - name of the account
-            * @param json_data - JSON string containing app details (name,description, logo_url, background_color, accent_color)
+            * @param metadata - details of the app (name, description, logo_url, background_color, accent_color)
             * @param username_hash - hash of the username
             * @param origin - domain associated with the app
           */
          [[eosio::action]] void adminsetapp(
              name account_name,
-             string json_data,
+             app_metadata metadata,
              checksum256 username_hash,
              string origin);
       /**
        * Create a new account for an app and registers its details
+       * The metadata record replaced the json_data string parameter, so callers built against the old ABI must be updated
        *
-       * @param json_data - JSON string containing app details (name,description, logo_url, background_color, accent_color)
+       * @param metadata - Details of the app (name, description, logo_url, background_color, accent_color)
        * @param username_hash - Hash of the username
        * @param origin - Domain associated with the app
        * @param key - Public key generated from the account's password
        */
       [[eosio::action]] void newapp(
-          string json_data,
+          app_metadata metadata,
           checksum256 username_hash,
           string origin,
           public_key key);
@@ -171,6 +217,15 @@ namespace tonomysystem
        */
        [[eosio::action]] void eraseoldapps();
 
+      /**
+       * Move apps from the appsv2 table to the appsv3 table
+       *
+       * @details The JSON string of each app is converted to app_metadata off-chain.
+       *
+       * @param apps - the apps to move, with their converted details
+       */
+      [[eosio::action]] void migrateapps(std::vector<app_migration> apps);
+
       /**
        * Buy RAM action allows an app to purchase RAM.
        * It checks the account type of the app, ensures the RAM is being purchased with the correct token,
@@ -285,6 +340,31 @@ namespace tonomysystem
       // Create an instance of the table that can is initalized in the constructor
       appsv2_table _appsv2;
 
+      struct [[eosio::table]] appv3
+      {
+         name account_name;
+         app_metadata metadata;
+         uint16_t version; // Version number to track schema changes
+         checksum256 username_hash;
+         string origin;
+         checksum256 origin_hash; // sha256 of origin, stored so that the index does not hash the origin on every write
+
+         uint64_t primary_key() const { return account_name.value; }
+         checksum256 index_by_username_hash() const { return username_hash; }
+         checksum256 index_by_origin_hash() const { return origin_hash; }
+      };
+
+      // Create a multi-index-table with two indexes
+      typedef eosio::multi_index<"appsv3"_n, appv3,
+                                 eosio::indexed_by<"usernamehash"_n,
+                                                   eosio::const_mem_fun<appv3, checksum256, &appv3::index_by_username_hash>>,
+                                 eosio::indexed_by<"originhash"_n,
+                                                   eosio::const_mem_fun<appv3, checksum256, &appv3::index_by_origin_hash>>>
+          appsv3_table;
+
+      // Create an instance of the table that can is initalized in the constructor
+      appsv3_table _appsv3;
+
       struct [[eosio::table]] resource_config
       {
          double ram_fee;                      // RAM fee fraction (0.01 = 1% fee)
@@ -341,28 +421,39 @@ namespace tonomysystem
       }
 
       using newperson_action = action_wrapper<"newperson"_n, &tonomy::newperson>;
+      using newpeople_action = action_wrapper<"newpeople"_n, &tonomy::newpeople>;
       using updatekeyper_action = action_wrapper<"updatekeyper"_n, &tonomy::updatekeyper>;
       using newapp_action = action_wrapper<"newapp"_n, &tonomy::newapp>;
       using loginwithapp_action = action_wrapper<"loginwithapp"_n, &tonomy::loginwithapp>;
       using adminsetapp_action = action_wrapper<"adminsetapp"_n, &tonomy::adminsetapp>;
       using setresparams_action = action_wrapper<"setresparams"_n, &tonomy::setresparams>;
       using eraseoldapps_action = action_wrapper<"eraseoldapps"_n, &tonomy::eraseoldapps>;
+      using migrateapps_action = action_wrapper<"migrateapps"_n, &tonomy::migrateapps>;
       using buyram_action = action_wrapper<"buyram"_n, &tonomy::buyram>;
       using sellram_action = action_wrapper<"sellram"_n, &tonomy::sellram>;
    
       private:
       /**
-       * Check if the app username is already taken
+       * Create the account of a person and store its details, the username must already be checked
+       *
+       * @param username_hash - hash of the username of the account
+       * @param password_key - public key generated from the account's password
+       * @param password_salt - salt used to generate the password_key with the password
+       */
+      void create_person(const checksum256 &username_hash, const public_key &password_key, const checksum256 &password_salt);
+
+      /**
+       * Check if the app username is already taken, in appsv3 or in appsv2 for apps not yet migrated
        *
        * @param username_hash - hash of the username of the account
        */    
       void check_app_username(const checksum256 &username_hash);
     
       /**
-       * Check if the app origin is already taken
+       * Check if the app origin is already taken, in appsv3 or in appsv2 for apps not yet migrated
        *
-       * @param origin - domain associated with the app
+       * @param origin_hash - sha256 of the domain associated with the app
        */
-      void check_app_origin(const string &origin);
+      void check_app_origin(const checksum256 &origin_hash);
    };
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include <tonomy/tonomy.hpp>
+#include <tonomy/name_encoding.hpp>
 #include <eosio/symbol.hpp>
 #include <eosio/transaction.hpp>
 #include <vector>
@@ -12,7 +13,8 @@ namespace tonomysystem
                                                                                   // instantiate multi-index instance as data member (find it defined below)
                                                                                   _people(receiver, receiver.value),
                                                                                   _apps(receiver, receiver.value),
-                                                                                  _appsv2(receiver, receiver.value)
+                                                                                  _appsv2(receiver, receiver.value),
+                                                                                  _appsv3(receiver, receiver.value)
    {
    }
 
@@ -21,12 +23,24 @@ namespace tonomysystem
       check(false, error_code + ": " + message);
    }
 
-   std::map<enum_account_type, char> account_type_letters = {
-       {enum_account_type::Person, 'p'},
-       {enum_account_type::App, 'a'},
-       {enum_account_type::Organization, 'o'},
-       {enum_account_type::Gov, 'g'},
-       {enum_account_type::Service, 's'}};
+   // The first character of the account names of each account type
+   constexpr char account_type_letter(const enum_account_type &account_type)
+   {
+      switch (account_type)
+      {
+      case enum_account_type::Person:
+         return 'p';
+      case enum_account_type::App:
+         return 'a';
+      case enum_account_type::Organization:
+         return 'o';
+      case enum_account_type::Gov:
+         return 'g';
+      case enum_account_type::Service:
+         return 's';
+      }
+      return '.';
+   }
 
    uint64_t uint64_t_from_checksum256(const checksum256 &hash)
    {
@@ -43,31 +57,52 @@ namespace tonomysystem
       return num;
    }
 
-   static constexpr char *charmap = (char *)"12345abcdefghijklmnopqrstuvwxyz";
+   void check_app_metadata(const tonomy::app_metadata &metadata)
+   {
+      check(metadata.version == tonomy::app_metadata_version, "Unsupported app metadata version");
+      check(metadata.name.size() <= tonomy::max_app_name_length, "App name is too long");
+      check(metadata.description.size() <= tonomy::max_app_description_length, "App description is too long");
+      check(metadata.logo_url.size() <= tonomy::max_app_logo_url_length, "App logo URL is too long");
+      check(metadata.background_color <= 0xFFFFFF, "Invalid app background color");
+      check(metadata.accent_color <= 0xFFFFFF, "Invalid app accent color");
+      check(metadata.extension.size() <= tonomy::max_app_extension_length, "App metadata extension is too long");
+   }
 
-   name tidy_name(const name &account_name, const uint8_t random_number, const enum_account_type &account_type)
+   // Turns a random number into a 12 character account name of an account type, see tidy_name_value()
+   constexpr name tidy_name(const name &account_name, const uint8_t random_number, const enum_account_type &account_type)
    {
-      std::string name_string = account_name.to_string();
+      return name(tidy_name_value(account_name.value, random_number, name::char_to_value(account_type_letter(account_type))));
+   }
 
-      // Set the first character to the account type
-      name_string[0] = account_type_letters[account_type];
+   static_assert(tidy_name(name(0), 0, enum_account_type::Person) == "p11111111111"_n);
+   static_assert(tidy_name("abcdefghijklj"_n, 7, enum_account_type::App) == "abcdefghijkl"_n);
+   static_assert(tidy_name("z..........z"_n, 2, enum_account_type::Gov) == "g35bdfhjlnpz"_n);
 
-      // Remove any . character and replace with random character
-      for (int i = 0; i < name_string.length(); i++)
-      {
-         if (name_string[i] == '.')
-         {
-            // TODO: if this is the last character then it must not be greater then 'f'
-            name_string[i] = charmap[(random_number * i) % 31];
-         }
-      }
+   // Maximum number of names tried by random_account_name before giving up
+   static constexpr uint8_t max_account_name_attempts = 8;
 
-      // remove last character (only 12 characters allowed)
-      name_string.erase(name_string.end() - 1);
-      return name(name_string);
+   // Mixes the bits of a 64 bit number (the splitmix64 finalizer)
+   uint64_t mix_uint64_t(uint64_t value)
+   {
+      value += 0x9e3779b97f4a7c15;
+      value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9;
+      value = (value ^ (value >> 27)) * 0x94d049bb133111eb;
+      return value ^ (value >> 31);
+   }
+
+   // An account name is taken if the account exists, or if it is being created by an earlier action in the transaction
+   bool is_account_name_taken(const tonomy::account_type_table &account_type, const name &account_name)
+   {
+      return eosio::is_account(account_name) || account_type.find(account_name.value) != account_type.end();
    }
 
-   name random_account_name(const checksum256 &hash1, const checksum256 &hash2, const enum_account_type &account_type)
+   /**
+    * Generates a random account name that is not taken
+    *
+    * @param is_taken - called with each candidate name, returns true if the name cannot be used
+    */
+   template <typename IsTaken>
+   name random_account_name(const checksum256 &hash1, const checksum256 &hash2, const enum_account_type &account_type, IsTaken &&is_taken)
    {
       // Put random input from the block header (32 bits) in the first and last 32 bits
       uint64_t tapos = eosio::tapos_block_prefix();
@@ -82,9 +117,20 @@ namespace tonomysystem
       hash_uint64_t = uint64_t_from_checksum256(hash2);
       name_uint64_t ^= hash_uint64_t << 32;
 
-      // TODO: go through and change any '.' character for a random character
-      name res = name(name_uint64_t);
-      return tidy_name(res, uint8_t(name_uint64_t), account_type);
+      for (uint8_t attempt = 0; attempt < max_account_name_attempts; attempt++)
+      {
+         name res = tidy_name(name(name_uint64_t), uint8_t(name_uint64_t), account_type);
+         if (!is_taken(res))
+         {
+            return res;
+         }
+
+         // Derive the next candidate from the previous one, so the result only depends on the inputs
+         name_uint64_t = mix_uint64_t(name_uint64_t);
+      }
+
+      throwError("TCON1003", "Could not generate an account name that is not taken");
+      return name();
    }
 
    authority create_authority_with_key(const eosio::public_key &key)
@@ -118,25 +164,63 @@ namespace tonomysystem
       // check the transaction is signed by the `id.tmy` account
       eosio::require_auth(get_self());
 
+      // Check the username is not already taken
+      auto people_by_username_hash_itr = _people.get_index<"usernamehash"_n>();
+      const auto username_itr = people_by_username_hash_itr.find(username_hash);
+      if (username_itr != people_by_username_hash_itr.end())
+      {
+         throwError("TCON1000", "This people username is already taken");
+      }
+
+      create_person(username_hash, password_key, password_salt);
+   }
+
+   void tonomy::newpeople(std::vector<new_person> people)
+   {
+      // check the transaction is signed by the `id.tmy` account
+      eosio::require_auth(get_self());
+      check(!people.empty(), "No people provided");
+      check(people.size() <= max_new_people, "Too many people provided");
+
+      // Check all the usernames before creating any account
+      auto people_by_username_hash_itr = _people.get_index<"usernamehash"_n>();
+      for (size_t i = 0; i < people.size(); i++)
+      {
+         const auto username_itr = people_by_username_hash_itr.find(people[i].username_hash);
+         if (username_itr != people_by_username_hash_itr.end())
+         {
+            throwError("TCON1000", "Entry " + std::to_string(i) + ": This people username is already taken");
+         }
+         for (size_t j = 0; j < i; j++)
+         {
+            if (people[j].username_hash == people[i].username_hash)
+            {
+               throwError("TCON1000", "Entry " + std::to_string(i) + ": This people username is already taken");
+            }
+         }
+      }
+
+      for (const new_person &person : people)
+      {
+         create_person(person.username_hash, person.password_key, person.password_salt);
+      }
+   }
+
+   void tonomy::create_person(const checksum256 &username_hash, const public_key &password_key, const checksum256 &password_salt)
+   {
       // generate new random account name
-      const name random_name = random_account_name(username_hash, password_salt, enum_account_type::Person);
+      account_type_table account_type(get_self(), get_self().value);
+      const name random_name = random_account_name(username_hash, password_salt, enum_account_type::Person, [&](const name &candidate)
+                                                   { return is_account_name_taken(account_type, candidate); });
 
       // use the password_key public key for the owner authority
       authority password_authority = create_authority_with_key(password_key);
       password_authority.accounts.push_back({.permission = create_eosio_code_permission_level(get_self()), .weight = 1});
 
-      // If the account name exists, this will fail
+      // The account name was checked to be unused by random_account_name
       newaccount_action newaccountaction("eosio"_n, {get_self(), "active"_n});
       newaccountaction.send(get_self(), random_name, password_authority, password_authority);
 
-      // Check the username is not already taken
-      auto people_by_username_hash_itr = _people.get_index<"usernamehash"_n>();
-      const auto username_itr = people_by_username_hash_itr.find(username_hash);
-      if (username_itr != people_by_username_hash_itr.end())
-      {
-         throwError("TCON1000", "This people username is already taken");
-      }
-
       // Store the password_salt and hashed username in table
       _people.emplace(get_self(), [&](auto &people_itr)
                       {
@@ -146,7 +230,6 @@ namespace tonomysystem
            people_itr.password_salt = password_salt; });
 
       // Store the account type in the account_type table
-      account_type_table account_type(get_self(), get_self().value);
       account_type.emplace(get_self(), [&](auto &row)
                            {
          row.account_name = random_name;
@@ -154,7 +237,7 @@ namespace tonomysystem
          row.version = 1; });
    }
 
-   void tonomy::newapp(string json_data,
+   void tonomy::newapp(app_metadata metadata,
       checksum256 username_hash,
       string origin,
       public_key key)
@@ -162,36 +245,28 @@ namespace tonomysystem
       // TODO: in the future only an organization type can create an app
       // check the transaction is signed by the `id.tmy` account
       eosio::require_auth(get_self());     
+      check_app_metadata(metadata);
 
       // generate new random account name
-      auto json_hash = eosio::sha256(json_data.c_str(), std::strlen(json_data.c_str()));
-      const eosio::name random_name = random_account_name(username_hash, json_hash, enum_account_type::App);
+      std::vector<char> packed_metadata = eosio::pack(metadata);
+      auto metadata_hash = eosio::sha256(packed_metadata.data(), packed_metadata.size());
+      account_type_table account_type(get_self(), get_self().value);
+      const eosio::name random_name = random_account_name(username_hash, metadata_hash, enum_account_type::App, [&](const name &candidate)
+                                                          { return is_account_name_taken(account_type, candidate); });
 
       // use the password_key public key for the owner authority
       authority owner_authority = create_authority_with_account(app_controller_account);
       authority active_authority = create_authority_with_key(key);
       active_authority.accounts.push_back({.permission = create_eosio_code_permission_level(get_self()), .weight = 1});
 
-      // If the account name exists, this will fail
+      // The account name was checked to be unused by random_account_name
       newaccount_action newaccountaction("eosio"_n, {get_self(), "active"_n});
       newaccountaction.send(get_self(), random_name, owner_authority, active_authority);
 
-      // Check the username is not already taken
-      auto apps_by_username_hash_itr = _appsv2.get_index<"usernamehash"_n>();
-      const auto username_itr = apps_by_username_hash_itr.find(username_hash);
-      if (username_itr != apps_by_username_hash_itr.end())
-      {
-         throwError("TCON1001", "This app username is already taken");
-      }
-
-      // Check the origin is not already taken
+      // Check the username and origin are not already taken
+      check_app_username(username_hash);
       auto origin_hash = eosio::sha256(origin.c_str(), std::strlen(origin.c_str()));
-      auto apps_by_origin_hash_itr = _appsv2.get_index<"originhash"_n>();
-      const auto origin_itr = apps_by_origin_hash_itr.find(origin_hash);
-      if (origin_itr != apps_by_origin_hash_itr.end())
-      {
-         throwError("TCON1002", "This app origin is already taken");
-      }
+      check_app_origin(origin_hash);
 
       tonomy::resource_config_table _resource_config(get_self(), get_self().value);
       auto config = _resource_config.get();
@@ -200,18 +275,18 @@ namespace tonomysystem
       _resource_config.set(config, get_self());
 
       // Store the password_salt and hashed username in table
-      // Store the app details in JSON format
-      _appsv2.emplace(get_self(), [&](auto &app_itr)
+      // Store the app details
+      _appsv3.emplace(get_self(), [&](auto &app_itr)
       {
          app_itr.account_name = random_name;
-         app_itr.json_data = json_data;
-         app_itr.version = 2; 
+         app_itr.metadata = metadata;
+         app_itr.version = 3;
          app_itr.username_hash = username_hash;
          app_itr.origin = origin;
+         app_itr.origin_hash = origin_hash;
       });
 
       // Store the account type in the account_type table
-      account_type_table account_type(get_self(), get_self().value);
       account_type.emplace(get_self(), [&](auto &row)
                            {
          row.account_name = random_name;
@@ -228,22 +303,50 @@ namespace tonomysystem
       }
    }  
    
+   void tonomy::migrateapps(std::vector<app_migration> apps)
+   {
+      eosio::require_auth(get_self());
+
+      // Each origin is hashed once here, instead of on every write of the app
+      for (const app_migration &migration : apps)
+      {
+         auto itr = _appsv2.find(migration.account_name.value);
+         if (itr == _appsv2.end())
+         {
+            check(false, "App " + migration.account_name.to_string() + " is not in appsv2");
+         }
+         check_app_metadata(migration.metadata);
+
+         _appsv3.emplace(get_self(), [&](auto &app_itr)
+         {
+            app_itr.account_name = itr->account_name;
+            app_itr.metadata = migration.metadata;
+            app_itr.version = 3;
+            app_itr.username_hash = itr->username_hash;
+            app_itr.origin = itr->origin;
+            app_itr.origin_hash = eosio::sha256(itr->origin.c_str(), std::strlen(itr->origin.c_str()));
+         });
+         _appsv2.erase(itr);
+      }
+   }
+
    void tonomy::check_app_username(const checksum256 &username_hash)
    {
       // Check the username is not already taken
-      auto apps_by_username_hash_itr = _appsv2.get_index<"usernamehash"_n>();
-      const auto username_itr = apps_by_username_hash_itr.find(username_hash);
-      if (username_itr != apps_by_username_hash_itr.end())
+      auto apps_by_username_hash_itr = _appsv3.get_index<"usernamehash"_n>();
+      auto legacy_apps_by_username_hash_itr = _appsv2.get_index<"usernamehash"_n>();
+      if (apps_by_username_hash_itr.find(username_hash) != apps_by_username_hash_itr.end() ||
+          legacy_apps_by_username_hash_itr.find(username_hash) != legacy_apps_by_username_hash_itr.end())
       {
          throwError("TCON1001", "This app username is already taken");
       }
    }
-   void tonomy::check_app_origin(const string &origin) {
+   void tonomy::check_app_origin(const checksum256 &origin_hash) {
       // Check the origin is not already taken
-      auto origin_hash = eosio::sha256(origin.c_str(), std::strlen(origin.c_str()));
-      auto apps_by_origin_hash_itr = _appsv2.get_index<"originhash"_n>();
-      const auto origin_itr = apps_by_origin_hash_itr.find(origin_hash);
-      if (origin_itr != apps_by_origin_hash_itr.end())
+      auto apps_by_origin_hash_itr = _appsv3.get_index<"originhash"_n>();
+      auto legacy_apps_by_origin_hash_itr = _appsv2.get_index<"originhash"_n>();
+      if (apps_by_origin_hash_itr.find(origin_hash) != apps_by_origin_hash_itr.end() ||
+          legacy_apps_by_origin_hash_itr.find(origin_hash) != legacy_apps_by_origin_hash_itr.end())
       {
          throwError("TCON1002", "This app origin is already taken");
       }
@@ -251,11 +354,12 @@ namespace tonomysystem
 
    void tonomy::adminsetapp(
       name account_name,
-      string json_data,
+      app_metadata metadata,
       checksum256 username_hash,
       string origin)
    {
       eosio::require_auth(get_self()); // signed by tonomy@active permission
+      check_app_metadata(metadata);
 
       // Add to the account_type table
       account_type_table account_type(get_self(), get_self().value);
@@ -271,32 +375,49 @@ namespace tonomysystem
       }
 
       // Check the account name is not already used
-      auto apps_itr = _appsv2.find(account_name.value);
+      auto apps_itr = _appsv3.find(account_name.value);
       
-      if (apps_itr != _appsv2.end())
+      if (apps_itr != _appsv3.end())
       {
-          if (apps_itr->origin != origin) {
-            check_app_origin(origin);
+          bool origin_changed = apps_itr->origin != origin;
+          checksum256 origin_hash = origin_changed ? eosio::sha256(origin.c_str(), std::strlen(origin.c_str())) : apps_itr->origin_hash;
+          if (origin_changed) {
+            check_app_origin(origin_hash);
           }
           if (apps_itr->username_hash != username_hash) {
             check_app_username(username_hash);
           }
-          _appsv2.modify(apps_itr, get_self(), [&](auto &app_itr) {
+          _appsv3.modify(apps_itr, get_self(), [&](auto &app_itr) {
             app_itr.account_name = account_name;
             app_itr.origin = origin;
+            app_itr.origin_hash = origin_hash;
             app_itr.username_hash = username_hash;
-            app_itr.json_data = json_data;
-            app_itr.version = 2; 
+            app_itr.metadata = metadata;
+            app_itr.version = 3;
           });
       } else {
-         check_app_username(username_hash);
-         check_app_origin(origin);
-         _appsv2.emplace(get_self(), [&](auto &app_itr) {
+         // An app not yet moved by migrateapps is moved now
+         auto legacy_itr = _appsv2.find(account_name.value);
+         bool keeps_origin = legacy_itr != _appsv2.end() && legacy_itr->origin == origin;
+         bool keeps_username = legacy_itr != _appsv2.end() && legacy_itr->username_hash == username_hash;
+         if (legacy_itr != _appsv2.end()) {
+            _appsv2.erase(legacy_itr);
+         }
+
+         checksum256 origin_hash = eosio::sha256(origin.c_str(), std::strlen(origin.c_str()));
+         if (!keeps_username) {
+            check_app_username(username_hash);
+         }
+         if (!keeps_origin) {
+            check_app_origin(origin_hash);
+         }
+         _appsv3.emplace(get_self(), [&](auto &app_itr) {
             app_itr.account_name = account_name;
             app_itr.origin = origin;
+            app_itr.origin_hash = origin_hash;
             app_itr.username_hash = username_hash;
-            app_itr.json_data = json_data;
-            app_itr.version = 2; 
+            app_itr.metadata = metadata;
+            app_itr.version = 3;
          });
       }
    }
@@ -376,8 +497,8 @@ namespace tonomysystem
       // eosio::require_auth(account); // this is not needed as tonomy::tonomy::updateauth_action checks the permission
 
       // check the app exists and is registered with status
-      auto app_itr = _appsv2.find(app.value);
-      check(app_itr != _appsv2.end(), "App does not exist");
+      auto app_itr = _appsv3.find(app.value);
+      check(app_itr != _appsv3.end() || _appsv2.find(app.value) != _appsv2.end(), "App does not exist");
 
       // TODO: uncomment when apps have status
       // check(app_itr->status == tonomy::enum_account_status::Active_Status, "App is not active");
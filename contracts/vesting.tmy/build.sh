@@ -7,4 +7,8 @@ cd "${PARENT_PATH}"
 
 source ../compile_contract.sh
 
+mkdir -p "${PARENT_PATH}/include/common"
+cp "${PARENT_PATH}/../common/include/common/merkle.hpp" "${PARENT_PATH}/include/common/merkle.hpp"
+cp "${PARENT_PATH}/../common/include/common/scope_migration.hpp" "${PARENT_PATH}/include/common/scope_migration.hpp"
+
 compile_contract "${PARENT_PATH}" "vesting.tmy" "${BUILD_METHOD}"
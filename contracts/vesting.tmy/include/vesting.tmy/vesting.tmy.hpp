@@ -7,11 +7,17 @@
 #include <eosio/asset.hpp>
 #include <eosio/system.hpp>
 #include <eosio/singleton.hpp>
+#include <common/merkle.hpp>
+#include <common/scope_migration.hpp>
+#include <vesting.tmy/vesting_schedule.hpp>
+
+#include <algorithm>
 
 namespace vestingtoken
 {
     using eosio::action_wrapper;
     using eosio::asset;
+    using eosio::checksum256;
     using eosio::check;
     using eosio::days;
     using eosio::microseconds;
@@ -20,43 +26,6 @@ namespace vestingtoken
     using eosio::time_point;
     using std::string;
 
-    struct vesting_category
-    {
-        microseconds cliff_period;
-        microseconds start_delay;
-        microseconds vesting_period;
-        double tge_unlock;
-    };
-
-    static const std::map<int, vesting_category> vesting_categories = {
-        // DEPRECIATED:
-        {1, {days(6 * 30), days(0 * 30), days(2 * 365), 0.0}}, // Seed Private Sale (DEPRECIATED),
-        {2, {days(6 * 30), days(6 * 30), days(2 * 365), 0.0}}, // Strategic Partnerships Private Sale (DEPRECIATED),
-        {3, {days(0 * 30), days(0 * 30), days(0 * 30), 0.0}},   // Public Sale (DEPRECIATED),
-        {5, {days(0 * 30), days(0 * 30), days(1 * 365), 0.0}},  // Legal and Compliance
-        // Unchanged:
-        {4, {days(0 * 30), days(1 * 365), days(5 * 365), 0.0}}, // Team
-        {6, {days(0 * 30), days(0 * 30), days(2 * 365), 0.0}},  // Reserves, Partnerships
-        {7, {days(0 * 30), days(0 * 30), days(5 * 365), 0.0}},  // Community & Marketing, Platform Dev, Staking & Infra Rewards, Ecosystem
-        // New (replacing depreciated):
-        {8, {days(0 * 30), days(6 * 30), days(12 * 30), 0.05}},  // Seed
-        {9, {days(0 * 30), days(4 * 30), days(12 * 30), 0.075}}, // Pre-sale
-        {10, {days(0 * 30), days(1 * 30), days(3 * 30), 0.25}},  // Public (TGE)
-        // New:
-        {11, {days(0 * 30), days(3 * 30), days(9 * 30), 0.125}}, // Private
-        {12, {days(0 * 30), days(1 * 30), days(3 * 30), 0.25}},  // KOL
-        {13, {days(0 * 30), days(0 * 30), days(6 * 30), 0.7}},   // Incubator
-        {14, {days(0 * 30), days(0 * 30), days(6 * 30), 0.25}},  // Liquidity
-
-        #ifdef BUILD_TEST
-        {997, {days(6 * 30), days(0 * 30), days(2 * 365), 0.0}},                  // TESTING ONLY
-        {998, {eosio::seconds(0), eosio::seconds(10), eosio::seconds(20), 0.5}},  // TESTING ONLY
-        {999, {eosio::seconds(10), eosio::seconds(10), eosio::seconds(20), 0.0}}, // TESTING ONLY
-        #endif
-    };
-
-    static const std::map<int, bool> depreciated_categories = {{1, true}, {2, true}};
-
     class [[eosio::contract("vesting.tmy")]] vestingToken : public eosio::contract
     {
     public:
@@ -69,6 +38,14 @@ namespace vestingtoken
         #else
             static const uint8_t MAX_ALLOCATIONS = 150;
         #endif
+        // Maximum depth of a round Merkle tree, enough for 2^32 buyers
+        static const uint8_t MAX_PROOF_LENGTH = 32;
+        // Maximum number of days returned by one unlockcal() call
+        static const uint16_t MAX_CALENDAR_DAYS = 1000;
+        // Maximum number of holders paid out by one distribute() call
+        static const uint32_t MAX_DISTRIBUTE_BATCH_SIZE = 100;
+        // Maximum number of allocations migrated by one migrate() call
+        static const uint32_t MAX_MIGRATE_BATCH_SIZE = 500;
         struct [[eosio::table]] vesting_settings
         {
             eosio::time_point sales_start_date;
@@ -82,6 +59,7 @@ namespace vestingtoken
         typedef eosio::multi_index<"settings"_n, vesting_settings> settings_table_dump;
 
         // Define the structure of a vesting schedule
+        // DEPRECIATED: replaced by vested_allocation_v2, rows are migrated with migraterows or when the holder is next used
         struct [[eosio::table]] vested_allocation
         {
             uint64_t id;
@@ -97,6 +75,112 @@ namespace vestingtoken
         // Define the mapping of vesting schedules
         typedef eosio::multi_index<"allocation"_n, vested_allocation> vesting_allocations;
 
+        // Compact structure of a vesting schedule. The table is scoped by holder and amounts are always in system_resource_currency
+        struct [[eosio::table]] vested_allocation_v2
+        {
+            uint64_t id;
+            int64_t tokens_allocated;
+            int64_t tokens_claimed;
+            uint16_t vesting_category_type;
+            uint64_t primary_key() const { return id; }
+            EOSLIB_SERIALIZE(struct vested_allocation_v2, (id)(tokens_allocated)(tokens_claimed)(vesting_category_type))
+        };
+
+        typedef eosio::multi_index<"allocationv2"_n, vested_allocation_v2> vesting_allocations_v2;
+
+        // Summary of all the allocations of a holder, so that withdraw() and assigntokens() do not need to iterate over them
+        struct [[eosio::table]] holder_summary
+        {
+            eosio::name holder;
+            uint16_t allocations;          // The number of allocation rows of the holder
+            eosio::asset total_allocated;  // The total tokens allocated to the holder
+            eosio::asset total_claimed;    // The total tokens withdrawn by the holder
+            microseconds next_unlock;      // Time after the launch date at which the claimable amount next changes
+            uint64_t primary_key() const { return holder.value; }
+            EOSLIB_SERIALIZE(struct holder_summary, (holder)(allocations)(total_allocated)(total_claimed)(next_unlock))
+        };
+
+        typedef eosio::multi_index<"summaries"_n, holder_summary> holder_summaries;
+
+        // Total allocated and claimed per vesting category, across all holders with a summary
+        struct [[eosio::table]] category_total
+        {
+            uint16_t category;
+            int64_t tokens_allocated;
+            int64_t tokens_claimed;
+            uint64_t primary_key() const { return category; }
+            EOSLIB_SERIALIZE(struct category_total, (category)(tokens_allocated)(tokens_claimed))
+        };
+
+        typedef eosio::multi_index<"cattotals"_n, category_total> category_totals;
+
+        // A sale round whose allocations are committed to by a Merkle root and created when each holder first claims
+        struct [[eosio::table]] allocation_round
+        {
+            uint64_t round;
+            eosio::name sender;              // The account that funded the round
+            checksum256 root;                // The Merkle root of the (holder, amount, category) allocations
+            eosio::asset total;              // The sum of the amounts of all leaves
+            eosio::asset materialized;       // The sum of the amounts of the allocations created so far
+            uint64_t leaves;                 // The number of leaves in the tree
+            bool closed;                     // Whether the unclaimed amount has been returned to the sender
+            uint64_t primary_key() const { return round; }
+            EOSLIB_SERIALIZE(struct allocation_round, (round)(sender)(root)(total)(materialized)(leaves)(closed))
+        };
+
+        typedef eosio::multi_index<"rounds"_n, allocation_round> allocation_rounds;
+
+        // Bitmap of the claimed leaves of a round, scoped by round. Each row holds 64 leaves.
+        struct [[eosio::table]] round_claims
+        {
+            uint64_t word; // The leaf index divided by 64
+            uint64_t bits; // Bit (index % 64) is set if the leaf has been claimed
+            uint64_t primary_key() const { return word; }
+            EOSLIB_SERIALIZE(struct round_claims, (word)(bits))
+        };
+
+        typedef eosio::multi_index<"roundclaims"_n, round_claims> round_claims_table;
+
+        // Configuration and cursor of the automated distribution of unlocked tokens
+        struct [[eosio::table]] distribution_state
+        {
+            bool enabled;
+            uint32_t batch_size;   // The maximum number of holders processed by each distribute() call
+            microseconds interval; // The minimum time between distribute() calls
+            uint64_t cursor;       // The holder that the next distribute() call starts from
+            eosio::time_point last_run;
+
+            EOSLIB_SERIALIZE(distribution_state, (enabled)(batch_size)(interval)(cursor)(last_run))
+        };
+
+        typedef eosio::singleton<"distribution"_n, distribution_state> distribution_table;
+        // Following line needed to correctly generate ABI. See https://github.com/EOSIO/eosio.cdt/issues/280#issuecomment-439666574
+        typedef eosio::multi_index<"distribution"_n, distribution_state> distribution_table_dump;
+
+        // Holders visited by migrate(), contract scoped
+        struct [[eosio::table]] migration_scope
+        {
+            eosio::name scope;
+            uint64_t primary_key() const { return scope.value; }
+            EOSLIB_SERIALIZE(struct migration_scope, (scope))
+        };
+
+        typedef eosio::multi_index<"migscopes"_n, migration_scope> migration_scopes;
+
+        // Cursor of the migration of the registered holders to the allocationv2 table
+        struct [[eosio::table]] migration_state
+        {
+            uint64_t cursor = 0;   // The first holder not yet fully migrated
+            uint64_t migrated = 0; // The number of allocations migrated by migrate()
+            bool complete = false;
+
+            EOSLIB_SERIALIZE(migration_state, (cursor)(migrated)(complete))
+        };
+
+        typedef eosio::singleton<"migration"_n, migration_state> migration_table;
+        // Following line needed to correctly generate ABI. See https://github.com/EOSIO/eosio.cdt/issues/280#issuecomment-439666574
+        typedef eosio::multi_index<"migration"_n, migration_state> migration_table_dump;
+
         /**
          * @details Updates the start date for vesting schedules to a new specified date
          *
@@ -120,6 +204,60 @@ namespace vestingtoken
          */
         [[eosio::action]] void assigntokens(eosio::name sender, eosio::name holder, eosio::asset amount, int category);
 
+        // An entry of an assignmany() batch
+        struct vesting_assignment
+        {
+            eosio::name holder;
+            eosio::asset amount;
+            int category;
+            EOSLIB_SERIALIZE(struct vesting_assignment, (holder)(amount)(category))
+        };
+
+        /**
+         * @details Assigns tokens to many holders, each with a specified vesting category.
+         * The total amount is transferred from the sender once, and invalid entries are reported by their index.
+         *
+         * @param sender {name} - The account name of the sender who is assigning the tokens.
+         * @param assignments {vesting_assignment[]} - The holder, amount and vesting category of each assignment.
+         */
+        [[eosio::action]] void assignmany(eosio::name sender, std::vector<vesting_assignment> assignments);
+
+        /**
+         * @details Creates a sale round from a Merkle root of its allocations, instead of one allocation row per buyer.
+         * The total is transferred from the sender, and each holder's allocation is created when they call claimround().
+         * Each leaf is merkle::hash_leaf(round, index, holder, amount, category) with amount as the int64 token amount and category as a uint16.
+         *
+         * @internal Auth required by the contract
+         *
+         * @param sender {name} - The account name of the sender who is funding the round.
+         * @param round {uint64_t} - The ID of the round.
+         * @param root {checksum256} - The Merkle root of the allocations.
+         * @param total {asset} - The sum of the amounts of all leaves.
+         * @param leaves {uint64_t} - The number of leaves in the tree.
+         */
+        [[eosio::action]] void setround(eosio::name sender, uint64_t round, checksum256 root, eosio::asset total, uint64_t leaves);
+
+        /**
+         * @details Creates a holder's allocation from a round with a Merkle proof, and withdraws any vested tokens if the launch date has been reached.
+         *
+         * @param holder {name} - The account name of the token holder.
+         * @param round {uint64_t} - The ID of the round.
+         * @param index {uint64_t} - The index of the holder's leaf in the tree.
+         * @param amount {asset} - The amount of tokens allocated to the holder.
+         * @param category {uint16_t} - The vesting category of the allocation.
+         * @param proof {checksum256[]} - The sibling hashes from the leaf up to the root.
+         */
+        [[eosio::action]] void claimround(eosio::name holder, uint64_t round, uint64_t index, eosio::asset amount, uint16_t category, std::vector<checksum256> proof);
+
+        /**
+         * @details Closes a round and returns the amount that has not been claimed to the sender.
+         *
+         * @internal Auth required by the contract
+         *
+         * @param round {uint64_t} - The ID of the round.
+         */
+        [[eosio::action]] void closeround(uint64_t round);
+
         /**
          * @details Allows a holder to withdraw vested tokens if the vesting conditions are met.
          *
@@ -127,6 +265,26 @@ namespace vestingtoken
          */
         [[eosio::action]] void withdraw(eosio::name holder);
 
+        /**
+         * @details Configures the automated distribution of unlocked tokens with distribute().
+         *
+         * @internal Auth required by the contract
+         *
+         * @param enabled {bool} - Whether distribute() can be called.
+         * @param batch_size {uint32_t} - The maximum number of holders processed by each distribute() call.
+         * @param interval_seconds {uint32_t} - The minimum time between distribute() calls, used to spread the payouts over time.
+         */
+        [[eosio::action]] void setdist(bool enabled, uint32_t batch_size, uint32_t interval_seconds);
+
+        /**
+         * @details Sends the unlocked tokens of the next batch of holders to them, as if each holder had called withdraw().
+         * Each call resumes from where the previous call stopped, and starts again from the first holder once all have been processed.
+         * Only holders with a summary are processed, see holder_summary.
+         *
+         * @internal Auth required by the contract, intended to be called by a cron job
+         */
+        [[eosio::action]] void distribute();
+
         /**
          * @details Migrates an allocation to a new amount and category
          *
@@ -140,14 +298,177 @@ namespace vestingtoken
          */
         [[eosio::action]] void migratealloc(eosio::name sender, name holder, uint64_t allocation_id, eosio::asset old_amount, eosio::asset new_amount, int old_category_id, int new_category_id);
 
+        /**
+         * @details Merges the allocations of a holder that have the same vesting category into one allocation per category.
+         * The allocated and claimed amounts are summed, so the vesting schedule of the holder is unchanged.
+         *
+         * @internal Auth required by the holder or the contract
+         *
+         * @param holder {name} - The account name of the token holder.
+         */
+        [[eosio::action]] void compact(eosio::name holder);
+
         /**
          * Migrates the allocation symbols of an account from the old symbol to the new symbol
          */
         [[eosio::action]] void migrateacc(const name &account);
 
+        /**
+         * @details Migrates the allocations of holders to the compact allocationv2 table.
+         * Holders are migrated in order until max_rows allocations have been migrated, call again with the remaining holders.
+         *
+         * @internal Auth required by the contract
+         *
+         * @param holders {name[]} - The account names of the token holders to migrate.
+         * @param max_rows {uint32_t} - The maximum number of allocations to migrate.
+         */
+        [[eosio::action]] void migraterows(std::vector<eosio::name> holders, uint32_t max_rows);
+
+        /**
+         * @details Adds holders to the list of holders visited by migrate().
+         *
+         * @internal Auth required by the contract
+         *
+         * @param holders {name[]} - The account names of holders that may have allocations in the legacy table.
+         */
+        [[eosio::action]] void regscopes(std::vector<eosio::name> holders);
+
+        /**
+         * @details Migrates the allocations of the registered holders to the allocationv2 table and creates their summaries,
+         * continuing from where the previous call stopped. Call repeatedly until it returns true.
+         *
+         * @internal Auth required by the contract
+         *
+         * @param batch_size {uint32_t} - The maximum number of allocations to migrate.
+         * @returns true if all registered holders have been migrated
+         */
+        [[eosio::action]] bool migrate(uint32_t batch_size);
+
+        // The claimable amount of an allocation, returned by claimable()
+        struct allocation_claimable
+        {
+            uint64_t id;
+            int vesting_category_type;
+            eosio::asset tokens_allocated;
+            eosio::asset tokens_claimed;
+            eosio::asset tokens_claimable; // The amount that withdraw() would send now
+            EOSLIB_SERIALIZE(struct allocation_claimable, (id)(vesting_category_type)(tokens_allocated)(tokens_claimed)(tokens_claimable))
+        };
+
+        /**
+         * @details Returns the amount that each allocation of a holder can withdraw now.
+         * Read-only action, computed with the same code as withdraw().
+         *
+         * @param holder {name} - The account name of the token holder.
+         * @returns the claimable amount of each allocation
+         */
+        [[eosio::action, eosio::read_only]] std::vector<allocation_claimable> claimable(eosio::name holder);
+
+        /**
+         * @details Returns the cumulative amount unlocked for a holder at each of the requested times.
+         * Read-only action, computed with the same code as withdraw().
+         *
+         * @param holder {name} - The account name of the token holder.
+         * @param times {time_point[]} - The times to sample the unlock curve at.
+         * @returns the total amount unlocked across the current allocations of the holder at each time
+         */
+        [[eosio::action, eosio::read_only]] std::vector<eosio::asset> unlockcurve(eosio::name holder, std::vector<eosio::time_point> times);
+
+        /**
+         * @details Returns the next time at which the claimable amount of a holder changes.
+         * Once an allocation's cliff has finished its claimable amount changes continuously, so the current time is returned.
+         * Read-only action.
+         *
+         * @param holder {name} - The account name of the token holder.
+         * @returns the next unlock time, or the maximum time if the holder has no allocations
+         */
+        [[eosio::action, eosio::read_only]] eosio::time_point nextunlock(eosio::name holder);
+
+        /**
+         * @details Returns the total amount unlocking on each day, across all holders.
+         * Computed from the category totals, as all allocations in a category share the same schedule.
+         * Read-only action.
+         *
+         * @param start {time_point} - The start of the first day.
+         * @param days {uint16_t} - The number of days to return.
+         * @returns the amount unlocking in each 24 hour period from start
+         */
+        [[eosio::action, eosio::read_only]] std::vector<eosio::asset> unlockcal(eosio::time_point start, uint16_t days);
+
         using setsettings_action = action_wrapper<"setsettings"_n, &vestingToken::setsettings>;
         using assigntokens_action = action_wrapper<"assigntokens"_n, &vestingToken::assigntokens>;
+        using assignmany_action = action_wrapper<"assignmany"_n, &vestingToken::assignmany>;
         using withdraw_action = action_wrapper<"withdraw"_n, &vestingToken::withdraw>;
+        using distribute_action = action_wrapper<"distribute"_n, &vestingToken::distribute>;
         using migratealloc_action = action_wrapper<"migratealloc"_n, &vestingToken::migratealloc>;
+
+    private:
+        /**
+         * Sends the unlocked tokens of a holder to them and updates their allocations and summary
+         *
+         * @param holder {name} - The account name of the token holder.
+         * @param settings - the contract settings
+         * @param now - the current time, which must be after the launch date
+         * @param summaries - the summaries table
+         */
+        void release_unlocked(const eosio::name &holder, const vesting_settings &settings, time_point now, holder_summaries &summaries);
+
+        /**
+         * Returns the summary of a holder, creating it from the holder's allocations if it does not exist yet
+         *
+         * @param summaries - the summaries table
+         * @param holder {name} - The account name of the token holder.
+         * @param since_launch {microseconds} - The time since the launch date.
+         * @returns an iterator to the summary of the holder
+         */
+        holder_summaries::const_iterator get_or_create_summary(holder_summaries &summaries, const eosio::name &holder, microseconds since_launch);
+
+        /**
+         * Adds a vesting allocation to a holder, unless the holder already has MAX_ALLOCATIONS allocations
+         *
+         * @param holder {name} - The account name of the token holder.
+         * @param amount {asset} - The amount of tokens to be assigned.
+         * @param category_id {integer} - The vesting category for the assigned tokens.
+         * @param settings - the contract settings
+         * @param now - the current time
+         * @param summaries - the summaries table
+         * @returns false if the holder has too many allocations
+         */
+        bool add_allocation(const eosio::name &holder, const eosio::asset &amount, int category_id, const vesting_settings &settings, time_point now, holder_summaries &summaries);
+
+
+        /**
+         * Migrates the allocations of a holder from the allocation table to the allocationv2 table
+         *
+         * @param holder {name} - The account name of the token holder.
+         * @param max_rows {uint32_t} - The maximum number of allocations to migrate.
+         * @returns the number of allocations migrated
+         */
+        uint32_t migrate_allocations(const eosio::name &holder, uint32_t max_rows);
+
+        /**
+         * Adds to the total allocated and claimed of a vesting category
+         */
+        void add_category_total(uint16_t category_id, int64_t tokens_allocated, int64_t tokens_claimed);
+
+        /**
+         * Calls fn with each allocation of a holder, including those not yet migrated to the allocationv2 table
+         * Used by read-only actions, which cannot migrate the allocations
+         */
+        template <typename F>
+        void for_each_allocation(const eosio::name &holder, F &&fn)
+        {
+            vesting_allocations_v2 vesting_table(get_self(), holder.value);
+            for (auto iter = vesting_table.begin(); iter != vesting_table.end(); ++iter)
+            {
+                fn(*iter);
+            }
+
+            vesting_allocations legacy_table(get_self(), holder.value);
+            for (auto iter = legacy_table.begin(); iter != legacy_table.end(); ++iter)
+            {
+                fn(vested_allocation_v2{iter->id, iter->tokens_allocated.amount, iter->tokens_claimed.amount, static_cast<uint16_t>(iter->vesting_category_type)});
+            }
+        }
     };
-}
+}
\ No newline at end of file
@@ -0,0 +1,127 @@
+// vesting_schedule.hpp
+
+#pragma once
+
+// The vesting categories and schedule, without any eosio dependency so they can also be built natively
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace vestingtoken
+{
+    static constexpr int64_t SECOND_MICROSECONDS = 1000000;
+    static constexpr int64_t DAY_MICROSECONDS = 24 * 60 * 60 * SECOND_MICROSECONDS;
+
+    struct vesting_category
+    {
+        int id;
+        int64_t cliff_period;   // microseconds
+        int64_t start_delay;    // microseconds
+        int64_t vesting_period; // microseconds
+        uint16_t tge_unlock;    // basis points, unlocked at the start of vesting
+        bool depreciated;
+    };
+
+    // Sorted by id. Ids from 1 to MAX_VESTING_CATEGORY_ID are stored at index id - 1, so lookup is a direct index
+    static constexpr std::array vesting_categories = {
+        // DEPRECIATED:
+        vesting_category{1, 6 * 30 * DAY_MICROSECONDS, 0 * 30 * DAY_MICROSECONDS, 2 * 365 * DAY_MICROSECONDS, 0, true},   // Seed Private Sale (DEPRECIATED),
+        vesting_category{2, 6 * 30 * DAY_MICROSECONDS, 6 * 30 * DAY_MICROSECONDS, 2 * 365 * DAY_MICROSECONDS, 0, true},   // Strategic Partnerships Private Sale (DEPRECIATED),
+        vesting_category{3, 0 * 30 * DAY_MICROSECONDS, 0 * 30 * DAY_MICROSECONDS, 0 * 30 * DAY_MICROSECONDS, 0, false},   // Public Sale (DEPRECIATED),
+        // Unchanged:
+        vesting_category{4, 0 * 30 * DAY_MICROSECONDS, 1 * 365 * DAY_MICROSECONDS, 5 * 365 * DAY_MICROSECONDS, 0, false}, // Team
+        vesting_category{5, 0 * 30 * DAY_MICROSECONDS, 0 * 30 * DAY_MICROSECONDS, 1 * 365 * DAY_MICROSECONDS, 0, false}, // Legal and Compliance (DEPRECIATED)
+        vesting_category{6, 0 * 30 * DAY_MICROSECONDS, 0 * 30 * DAY_MICROSECONDS, 2 * 365 * DAY_MICROSECONDS, 0, false}, // Reserves, Partnerships
+        vesting_category{7, 0 * 30 * DAY_MICROSECONDS, 0 * 30 * DAY_MICROSECONDS, 5 * 365 * DAY_MICROSECONDS, 0, false}, // Community & Marketing, Platform Dev, Staking & Infra Rewards, Ecosystem
+        // New (replacing depreciated):
+        vesting_category{8, 0 * 30 * DAY_MICROSECONDS, 6 * 30 * DAY_MICROSECONDS, 12 * 30 * DAY_MICROSECONDS, 500, false},  // Seed
+        vesting_category{9, 0 * 30 * DAY_MICROSECONDS, 4 * 30 * DAY_MICROSECONDS, 12 * 30 * DAY_MICROSECONDS, 750, false}, // Pre-sale
+        vesting_category{10, 0 * 30 * DAY_MICROSECONDS, 1 * 30 * DAY_MICROSECONDS, 3 * 30 * DAY_MICROSECONDS, 2500, false},  // Public (TGE)
+        // New:
+        vesting_category{11, 0 * 30 * DAY_MICROSECONDS, 3 * 30 * DAY_MICROSECONDS, 9 * 30 * DAY_MICROSECONDS, 1250, false}, // Private
+        vesting_category{12, 0 * 30 * DAY_MICROSECONDS, 1 * 30 * DAY_MICROSECONDS, 3 * 30 * DAY_MICROSECONDS, 2500, false},  // KOL
+        vesting_category{13, 0 * 30 * DAY_MICROSECONDS, 0 * 30 * DAY_MICROSECONDS, 6 * 30 * DAY_MICROSECONDS, 7000, false},   // Incubator
+        vesting_category{14, 0 * 30 * DAY_MICROSECONDS, 0 * 30 * DAY_MICROSECONDS, 6 * 30 * DAY_MICROSECONDS, 2500, false},  // Liquidity
+
+        #ifdef BUILD_TEST
+        vesting_category{997, 6 * 30 * DAY_MICROSECONDS, 0 * 30 * DAY_MICROSECONDS, 2 * 365 * DAY_MICROSECONDS, 0, false},          // TESTING ONLY
+        vesting_category{998, 0 * SECOND_MICROSECONDS, 10 * SECOND_MICROSECONDS, 20 * SECOND_MICROSECONDS, 5000, false},  // TESTING ONLY
+        vesting_category{999, 10 * SECOND_MICROSECONDS, 10 * SECOND_MICROSECONDS, 20 * SECOND_MICROSECONDS, 0, false}, // TESTING ONLY
+        #endif
+    };
+
+    static constexpr int64_t BASIS_POINTS = 10000;
+    // Longest vesting period for which vested_amount() cannot overflow 128 bit arithmetic
+    static constexpr int64_t MAX_VESTING_PERIOD = 100 * 365 * DAY_MICROSECONDS;
+
+    static constexpr int MAX_VESTING_CATEGORY_ID = 14;
+    #ifdef BUILD_TEST
+    // Testing categories are stored after the production categories
+    static constexpr int MIN_TEST_VESTING_CATEGORY_ID = 997;
+    #endif
+
+    /**
+     * Returns the index of a category in vesting_categories, or -1 if the id is not a category
+     */
+    constexpr int vesting_category_index(int category_id)
+    {
+        if (category_id >= 1 && category_id <= MAX_VESTING_CATEGORY_ID)
+            return category_id - 1;
+        #ifdef BUILD_TEST
+        if (category_id >= MIN_TEST_VESTING_CATEGORY_ID && category_id - MIN_TEST_VESTING_CATEGORY_ID + MAX_VESTING_CATEGORY_ID < static_cast<int>(vesting_categories.size()))
+            return category_id - MIN_TEST_VESTING_CATEGORY_ID + MAX_VESTING_CATEGORY_ID;
+        #endif
+        return -1;
+    }
+
+    /**
+     * Returns the vesting category with the given id, or nullptr if the id is not a category
+     */
+    constexpr const vesting_category *find_vesting_category(int category_id)
+    {
+        int index = vesting_category_index(category_id);
+        return index < 0 ? nullptr : &vesting_categories[index];
+    }
+
+    constexpr bool validate_vesting_categories()
+    {
+        for (size_t i = 0; i < vesting_categories.size(); i++)
+        {
+            const vesting_category &category = vesting_categories[i];
+            if (vesting_category_index(category.id) != static_cast<int>(i)) return false;
+            if (category.cliff_period < 0 || category.start_delay < 0 || category.vesting_period < 0) return false;
+            if (category.cliff_period > category.vesting_period) return false;
+            if (category.vesting_period > MAX_VESTING_PERIOD) return false;
+            if (category.tge_unlock > BASIS_POINTS) return false;
+        }
+        return true;
+    }
+
+    static_assert(validate_vesting_categories(), "vesting_categories must be sorted by id, densely indexed and have valid periods");
+
+    /**
+     * Returns the amount of an allocation that has vested
+     *
+     * @details The TGE unlock is released at the start of vesting and the rest vests linearly over the vesting period.
+     * Evaluated in 128 bit integer arithmetic and rounded down to the smallest token unit, so the result is
+     * exact, never exceeds tokens_allocated and never decreases as time passes.
+     *
+     * @param category - the vesting category of the allocation
+     * @param tokens_allocated - the amount of tokens allocated
+     * @param since_vesting_start - microseconds since the start of vesting (launch date + start delay)
+     * @returns the amount of tokens vested
+     */
+    constexpr int64_t vested_amount(const vesting_category &category, int64_t tokens_allocated, int64_t since_vesting_start)
+    {
+        if (since_vesting_start < category.cliff_period) return 0;
+        if (since_vesting_start >= category.vesting_period) return tokens_allocated;
+
+        // tokens_allocated * (tge_unlock + (1 - tge_unlock) * since_vesting_start / vesting_period)
+        __int128 numerator = static_cast<__int128>(tokens_allocated) *
+                             (static_cast<__int128>(category.tge_unlock) * category.vesting_period +
+                              static_cast<__int128>(BASIS_POINTS - category.tge_unlock) * since_vesting_start);
+        __int128 denominator = static_cast<__int128>(BASIS_POINTS) * category.vesting_period;
+        return static_cast<int64_t>(numerator / denominator);
+    }
+}
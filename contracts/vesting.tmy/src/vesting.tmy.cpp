@@ -13,8 +13,116 @@ namespace vestingtoken
 
     void check_category(int category_id)
     {
-        eosio::check(vesting_categories.contains(category_id), "Invalid new vesting category");
-        eosio::check(!depreciated_categories.contains(category_id), "New category is depreciated");
+        const vesting_category *category = find_vesting_category(category_id);
+        eosio::check(category != nullptr, "Invalid new vesting category");
+        eosio::check(!category->depreciated, "New category is depreciated");
+    }
+
+    // Reports a failed check of an entry of a batch by its index
+    void check_entry(bool condition, size_t index, const char *message)
+    {
+        if (!condition)
+        {
+            eosio::check(false, "Entry " + std::to_string(index) + ": " + message);
+        }
+    }
+
+    const vesting_category &get_vesting_category(int category_id)
+    {
+        const vesting_category *category = find_vesting_category(category_id);
+        eosio::check(category != nullptr, "Invalid vesting category");
+        return *category;
+    }
+
+    // Returns the time after the launch date at which the claimable amount of an allocation next changes.
+    // Once the cliff has finished the claimable amount changes continuously, so it is already due.
+    microseconds get_next_unlock(const vesting_category &category, microseconds since_launch)
+    {
+        microseconds cliff_finished = microseconds(category.start_delay + category.cliff_period);
+        return since_launch < cliff_finished ? cliff_finished : since_launch;
+    }
+
+    // Returns the total amount of an allocation that can have been withdrawn at a time
+    int64_t get_unlocked(const vestingToken::vested_allocation_v2 &allocation, const vesting_category &category, time_point launch_date, time_point at)
+    {
+        time_point vesting_start = launch_date + microseconds(category.start_delay);
+        int64_t unlocked = vested_amount(category, allocation.tokens_allocated, (at - vesting_start).count());
+
+        // The unlocked amount can never go below what was already claimed
+        return std::max(unlocked, allocation.tokens_claimed);
+    }
+
+    uint32_t vestingToken::migrate_allocations(const eosio::name &holder, uint32_t max_rows)
+    {
+        vesting_allocations legacy_table(get_self(), holder.value);
+        vesting_allocations_v2 vesting_table(get_self(), holder.value);
+
+        uint32_t migrated = 0;
+        for (auto iter = legacy_table.begin(); iter != legacy_table.end() && migrated < max_rows; migrated++)
+        {
+            // Allocations in the old symbol are migrated 1:1, as in migrateacc
+            vesting_table.emplace(get_self(), [&](auto &row)
+                                  {
+                row.id = iter->id;
+                row.tokens_allocated = iter->tokens_allocated.amount;
+                row.tokens_claimed = iter->tokens_claimed.amount;
+                row.vesting_category_type = static_cast<uint16_t>(iter->vesting_category_type); });
+
+            iter = legacy_table.erase(iter);
+        }
+        return migrated;
+    }
+
+    vestingToken::holder_summaries::const_iterator vestingToken::get_or_create_summary(holder_summaries &summaries, const eosio::name &holder, microseconds since_launch)
+    {
+        auto summary_itr = summaries.find(holder.value);
+        if (summary_itr != summaries.end())
+        {
+            return summary_itr;
+        }
+
+        // Holders with allocations from before summaries were introduced are counted once,
+        // which is also when their allocations are added to the category totals
+        uint16_t allocations = 0;
+        int64_t total_allocated = 0;
+        int64_t total_claimed = 0;
+        microseconds next_unlock = microseconds::maximum();
+        for_each_allocation(holder, [&](const vested_allocation_v2 &allocation)
+                            {
+            allocations++;
+            total_allocated += allocation.tokens_allocated;
+            total_claimed += allocation.tokens_claimed;
+            next_unlock = std::min(next_unlock, get_next_unlock(get_vesting_category(allocation.vesting_category_type), since_launch));
+            add_category_total(allocation.vesting_category_type, allocation.tokens_allocated, allocation.tokens_claimed); });
+
+        return summaries.emplace(get_self(), [&](auto &row)
+                                 {
+            row.holder = holder;
+            row.allocations = allocations;
+            row.total_allocated = eosio::asset(total_allocated, system_resource_currency);
+            row.total_claimed = eosio::asset(total_claimed, system_resource_currency);
+            row.next_unlock = next_unlock; });
+    }
+
+    void vestingToken::add_category_total(uint16_t category_id, int64_t tokens_allocated, int64_t tokens_claimed)
+    {
+        category_totals totals(get_self(), get_self().value);
+        auto itr = totals.find(category_id);
+        if (itr == totals.end())
+        {
+            totals.emplace(get_self(), [&](auto &row)
+                           {
+                row.category = category_id;
+                row.tokens_allocated = tokens_allocated;
+                row.tokens_claimed = tokens_claimed; });
+        }
+        else
+        {
+            totals.modify(itr, eosio::same_payer, [&](auto &row)
+                          {
+                row.tokens_allocated += tokens_allocated;
+                row.tokens_claimed += tokens_claimed; });
+        }
     }
 
     void vestingToken::setsettings(string sales_date_str, string launch_date_str)
@@ -29,21 +137,45 @@ namespace vestingtoken
         settings_table_instance.set(settings, get_self());
     }
 
-    void vestingToken::assigntokens(eosio::name sender, eosio::name holder, eosio::asset amount, int category_id)
+    bool vestingToken::add_allocation(const eosio::name &holder, const eosio::asset &amount, int category_id, const vesting_settings &settings, time_point now, holder_summaries &summaries)
     {
-        check_category(category_id);
-        check_asset(amount);
-
         // Create a new vesting schedule
-        vesting_allocations vesting_table(get_self(), holder.value);
+        migrate_allocations(holder, MAX_ALLOCATIONS);
+        vesting_allocations_v2 vesting_table(get_self(), holder.value);
 
         // Prevent unbounded array iteration DoS. If too many rows are added to the table, the user
         // may no longer be able to withdraw from the account.
         // For more information, see https://swcregistry.io/docs/SWC-128/
-        std::ptrdiff_t allocations_count = std::distance(vesting_table.begin(), vesting_table.end());
-        eosio::check(allocations_count < MAX_ALLOCATIONS, "Too many purchases received on this account.");
+        auto summary_itr = get_or_create_summary(summaries, holder, now - settings.launch_date);
+        if (summary_itr->allocations >= MAX_ALLOCATIONS)
+        {
+            return false;
+        }
+
+        vesting_table.emplace(get_self(), [&](auto &row)
+                              {
+            row.id = vesting_table.available_primary_key();
+            row.tokens_allocated = amount.amount;
+            row.tokens_claimed = 0;
+            row.vesting_category_type = static_cast<uint16_t>(category_id); });
+
+        add_category_total(static_cast<uint16_t>(category_id), amount.amount, 0);
+
+        summaries.modify(summary_itr, get_self(), [&](auto &row)
+                         {
+            row.allocations++;
+            row.total_allocated += amount;
+            row.next_unlock = std::min(row.next_unlock, get_next_unlock(get_vesting_category(category_id), microseconds(0))); });
+
+        eosio::require_recipient(holder);
+        return true;
+    }
+
+    void vestingToken::assigntokens(eosio::name sender, eosio::name holder, eosio::asset amount, int category_id)
+    {
+        check_category(category_id);
+        check_asset(amount);
 
-        // Calculate the number of seconds since sales start
         time_point now = eosio::current_time_point();
 
         settings_table settings_table_instance(get_self(), get_self().value);
@@ -51,81 +183,222 @@ namespace vestingtoken
 
         eosio::check(now >= settings.sales_start_date, "Sale has not yet started");
 
-        microseconds time_since_sale_start = now - settings.sales_start_date;
+        holder_summaries summaries(get_self(), get_self().value);
+        eosio::check(add_allocation(holder, amount, category_id, settings, now, summaries), "Too many purchases received on this account.");
 
-        vesting_table.emplace(get_self(), [&](auto &row)
-                              {
-            row.id = vesting_table.available_primary_key();
-            row.holder = holder;
-            row.tokens_allocated = amount;
-            row.tokens_claimed = eosio::asset(0, amount.symbol);
-            row.time_since_sale_start = time_since_sale_start;
-            row.vesting_category_type = category_id; });
+        eosio::action({sender, "active"_n},
+                      token_contract_name,
+                      "transfer"_n,
+                      std::make_tuple(sender, get_self(), amount, std::string("Allocated vested funds")))
+            .send(); // This will also run eosio::require_auth(sender)
+    }
 
-        eosio::require_recipient(holder);
+    void vestingToken::assignmany(eosio::name sender, std::vector<vesting_assignment> assignments)
+    {
+        eosio::check(!assignments.empty(), "No assignments provided");
+
+        time_point now = eosio::current_time_point();
+
+        settings_table settings_table_instance(get_self(), get_self().value);
+        vesting_settings settings = settings_table_instance.get();
+
+        eosio::check(now >= settings.sales_start_date, "Sale has not yet started");
+
+        holder_summaries summaries(get_self(), get_self().value);
+        eosio::asset total = eosio::asset(0, system_resource_currency);
+
+        for (size_t i = 0; i < assignments.size(); i++)
+        {
+            const vesting_assignment &assignment = assignments[i];
+
+            const vesting_category *category = find_vesting_category(assignment.category);
+            check_entry(category != nullptr, i, "Invalid new vesting category");
+            check_entry(!category->depreciated, i, "New category is depreciated");
+            check_entry(assignment.amount.symbol == system_resource_currency, i, "Symbol does not match system resource currency");
+            check_entry(assignment.amount.amount > 0, i, "Amount must be greater than 0");
+            check_entry(eosio::is_account(assignment.holder), i, "Holder account does not exist");
+
+            check_entry(add_allocation(assignment.holder, assignment.amount, assignment.category, settings, now, summaries), i, "Too many purchases received on this account.");
+
+            total += assignment.amount;
+        }
 
         eosio::action({sender, "active"_n},
                       token_contract_name,
                       "transfer"_n,
-                      std::make_tuple(sender, get_self(), amount, std::string("Allocated vested funds")))
+                      std::make_tuple(sender, get_self(), total, std::string("Allocated vested funds")))
+            .send(); // This will also run eosio::require_auth(sender)
+    }
+
+    void vestingToken::setround(eosio::name sender, uint64_t round, checksum256 root, eosio::asset total, uint64_t leaves)
+    {
+        require_auth(get_self());
+        check_asset(total);
+        eosio::check(leaves > 0, "Leaves must be greater than 0");
+
+        allocation_rounds rounds(get_self(), get_self().value);
+        eosio::check(rounds.find(round) == rounds.end(), "Round already exists");
+
+        rounds.emplace(get_self(), [&](auto &row)
+                       {
+            row.round = round;
+            row.sender = sender;
+            row.root = root;
+            row.total = total;
+            row.materialized = eosio::asset(0, system_resource_currency);
+            row.leaves = leaves;
+            row.closed = false; });
+
+        eosio::action({sender, "active"_n},
+                      token_contract_name,
+                      "transfer"_n,
+                      std::make_tuple(sender, get_self(), total, std::string("Allocated vested funds")))
             .send(); // This will also run eosio::require_auth(sender)
     }
 
+    void vestingToken::claimround(eosio::name holder, uint64_t round, uint64_t index, eosio::asset amount, uint16_t category, std::vector<checksum256> proof)
+    {
+        require_auth(holder);
+        check_category(category);
+        check_asset(amount);
+        eosio::check(proof.size() <= MAX_PROOF_LENGTH, "Proof is too long");
+
+        allocation_rounds rounds(get_self(), get_self().value);
+        auto round_itr = rounds.find(round);
+        eosio::check(round_itr != rounds.end(), "Round not found");
+        eosio::check(!round_itr->closed, "Round is closed");
+        eosio::check(index < round_itr->leaves, "Invalid leaf index");
+
+        round_claims_table claims(get_self(), round);
+        uint64_t word = index / 64;
+        uint64_t bit = uint64_t(1) << (index % 64);
+        auto claims_itr = claims.find(word);
+        eosio::check(claims_itr == claims.end() || (claims_itr->bits & bit) == 0, "Allocation already claimed");
+
+        checksum256 leaf = merkle::hash_leaf(round, index, holder, amount.amount, category);
+        eosio::check(merkle::verify_proof(leaf, proof, round_itr->root), "Invalid Merkle proof");
+
+        if (claims_itr == claims.end())
+        {
+            claims.emplace(get_self(), [&](auto &row)
+                           {
+                row.word = word;
+                row.bits = bit; });
+        }
+        else
+        {
+            claims.modify(claims_itr, eosio::same_payer, [&](auto &row)
+                          { row.bits |= bit; });
+        }
+
+        eosio::check(round_itr->materialized + amount <= round_itr->total, "Allocation exceeds the round total");
+        rounds.modify(round_itr, eosio::same_payer, [&](auto &row)
+                      { row.materialized += amount; });
+
+        time_point now = eosio::current_time_point();
+
+        settings_table settings_table_instance(get_self(), get_self().value);
+        vesting_settings settings = settings_table_instance.get();
+
+        holder_summaries summaries(get_self(), get_self().value);
+        eosio::check(add_allocation(holder, amount, category, settings, now, summaries), "Too many purchases received on this account.");
+
+        if (now >= settings.launch_date)
+        {
+            release_unlocked(holder, settings, now, summaries);
+        }
+    }
+
+    void vestingToken::closeround(uint64_t round)
+    {
+        require_auth(get_self());
+
+        allocation_rounds rounds(get_self(), get_self().value);
+        auto round_itr = rounds.find(round);
+        eosio::check(round_itr != rounds.end(), "Round not found");
+        eosio::check(!round_itr->closed, "Round is already closed");
+
+        eosio::asset unclaimed = round_itr->total - round_itr->materialized;
+        rounds.modify(round_itr, eosio::same_payer, [&](auto &row)
+                      { row.closed = true; });
+
+        if (unclaimed.amount > 0)
+        {
+            eosio::action({get_self(), "active"_n},
+                          token_contract_name,
+                          "transfer"_n,
+                          std::make_tuple(get_self(), round_itr->sender, unclaimed, std::string("Refunded vested funds")))
+                .send();
+        }
+    }
+
     void vestingToken::withdraw(eosio::name holder)
     {
         require_auth(holder);
 
-        // Get the vesting allocations
-        vesting_allocations vesting_table(get_self(), holder.value);
         time_point now = eosio::current_time_point();
 
         settings_table settings_table_instance(get_self(), get_self().value);
         vesting_settings settings = settings_table_instance.get();
 
+        eosio::check(now >= settings.launch_date, "Launch date not yet reached");
+
+        holder_summaries summaries(get_self(), get_self().value);
+        release_unlocked(holder, settings, now, summaries);
+    }
+
+    void vestingToken::release_unlocked(const eosio::name &holder, const vesting_settings &settings, time_point now, holder_summaries &summaries)
+    {
+        // Get the vesting allocations
+        migrate_allocations(holder, MAX_ALLOCATIONS);
+        vesting_allocations_v2 vesting_table(get_self(), holder.value);
+
         time_point launch_date = settings.launch_date;
-        eosio::check(now >= launch_date, "Launch date not yet reached");
+        microseconds since_launch = now - launch_date;
+        auto summary_itr = get_or_create_summary(summaries, holder, since_launch);
+
+        // Nothing has unlocked since the last withdraw
+        if (since_launch < summary_itr->next_unlock)
+        {
+            return;
+        }
 
         int64_t total_claimable = 0;
-        
+        uint16_t allocations = 0;
+        microseconds next_unlock = microseconds::maximum();
+        // The amount claimed from each vesting category, at most one entry per category
+        std::vector<std::pair<uint16_t, int64_t>> category_claims;
+
         for (auto iter = vesting_table.begin(); iter != vesting_table.end();)
         {
-            const vested_allocation &vesting_allocation = *iter;
-
-            vesting_category category = vesting_categories.at(vesting_allocation.vesting_category_type);
+            const vested_allocation_v2 &vesting_allocation = *iter;
 
-            time_point vesting_start = launch_date + category.start_delay;
-            time_point cliff_finished = vesting_start + category.cliff_period;
+            const vesting_category &category = get_vesting_category(vesting_allocation.vesting_category_type);
 
-            // Calculate the vesting end time
-            time_point vesting_end = vesting_start + category.vesting_period;
+            time_point vesting_start = launch_date + microseconds(category.start_delay);
+            time_point cliff_finished = vesting_start + microseconds(category.cliff_period);
 
             // Check if vesting period after cliff has started
             if (now >= cliff_finished)
             {
                 // Calculate the total claimable amount
-                int64_t claimable = 0;
-                if (now >= vesting_end)
+                int64_t claimable = get_unlocked(vesting_allocation, category, launch_date, now);
+
+                int64_t claimed = claimable - vesting_allocation.tokens_claimed;
+                total_claimable += claimed;
+
+                auto category_claim = std::find_if(category_claims.begin(), category_claims.end(), [&](const auto &pair)
+                                                   { return pair.first == vesting_allocation.vesting_category_type; });
+                if (category_claim == category_claims.end())
                 {
-                    claimable = vesting_allocation.tokens_allocated.amount;
+                    category_claims.push_back({vesting_allocation.vesting_category_type, claimed});
                 }
                 else
                 {
-                    // Calculate the percentage of the vesting period that has passed
-                    double vesting_finished = static_cast<double>((now - vesting_start).count()) / category.vesting_period.count();
-                    // Calculate the claimable amount:
-                    // + tokens allocated * TGE unlock percentage
-                    // + tokens allocated * % of vesting time that has passed * what is left after TGE unlock
-                    claimable = vesting_allocation.tokens_allocated.amount * ((1.0 - category.tge_unlock) * vesting_finished + category.tge_unlock);
-                    // Ensure the claimable amount is not greater than the total allocated amount
-                    claimable = std::min(claimable, vesting_allocation.tokens_allocated.amount);
+                    category_claim->second += claimed;
                 }
 
-                total_claimable += claimable - vesting_allocation.tokens_claimed.amount;
-
-                // Update the tokens_claimed field
-                eosio::asset tokens_claimed = eosio::asset(claimable, vesting_allocation.tokens_claimed.symbol);
-
-                if (claimable == vesting_allocation.tokens_allocated.amount)
+                if (claimable == vesting_allocation.tokens_allocated)
                 {
                     // Erase and update iterator correctly
                     iter = vesting_table.erase(iter);
@@ -134,17 +407,34 @@ namespace vestingtoken
                 {
                     vesting_table.modify(iter, get_self(), [&](auto &row)
                     {
-                        row.tokens_claimed = tokens_claimed;
+                        row.tokens_claimed = claimable;
                     });
+                    allocations++;
+                    next_unlock = std::min(next_unlock, get_next_unlock(category, since_launch));
                     ++iter;
                 }
             }
             else
             {
+                allocations++;
+                next_unlock = std::min(next_unlock, get_next_unlock(category, since_launch));
                 ++iter; 
             }
         }
 
+        summaries.modify(summary_itr, get_self(), [&](auto &row)
+                         {
+            row.allocations = allocations;
+            row.total_claimed += eosio::asset(total_claimable, system_resource_currency);
+            row.next_unlock = next_unlock; });
+
+        for (const auto &category_claim : category_claims)
+        {
+            if (category_claim.second > 0)
+            {
+                add_category_total(category_claim.first, 0, category_claim.second);
+            }
+        }
 
         if (total_claimable > 0)
         {
@@ -159,6 +449,168 @@ namespace vestingtoken
         }
     }
 
+    void vestingToken::setdist(bool enabled, uint32_t batch_size, uint32_t interval_seconds)
+    {
+        require_auth(get_self());
+        eosio::check(batch_size > 0 && batch_size <= MAX_DISTRIBUTE_BATCH_SIZE, "Batch size must be between 1 and " + std::to_string(MAX_DISTRIBUTE_BATCH_SIZE));
+
+        distribution_table distribution_instance(get_self(), get_self().value);
+        distribution_state state = distribution_instance.get_or_default({false, 0, microseconds(0), 0, time_point()});
+        state.enabled = enabled;
+        state.batch_size = batch_size;
+        state.interval = eosio::seconds(interval_seconds);
+        distribution_instance.set(state, get_self());
+    }
+
+    void vestingToken::distribute()
+    {
+        require_auth(get_self());
+
+        distribution_table distribution_instance(get_self(), get_self().value);
+        eosio::check(distribution_instance.exists(), "Distribution is not configured");
+        distribution_state state = distribution_instance.get();
+        eosio::check(state.enabled, "Distribution is not enabled");
+
+        time_point now = eosio::current_time_point();
+        eosio::check(now >= state.last_run + state.interval, "Distribution was called too recently");
+
+        settings_table settings_table_instance(get_self(), get_self().value);
+        vesting_settings settings = settings_table_instance.get();
+        eosio::check(now >= settings.launch_date, "Launch date not yet reached");
+
+        microseconds since_launch = now - settings.launch_date;
+        holder_summaries summaries(get_self(), get_self().value);
+
+        // Resume from the holder after the last one processed by the previous batch
+        auto itr = summaries.lower_bound(state.cursor);
+        uint32_t processed = 0;
+        while (itr != summaries.end() && processed < state.batch_size)
+        {
+            eosio::name holder = itr->holder;
+            // Holders with nothing due are skipped without reading their allocations
+            bool due = since_launch >= itr->next_unlock;
+            ++itr;
+
+            if (due)
+            {
+                release_unlocked(holder, settings, now, summaries);
+            }
+            processed++;
+            state.cursor = holder.value + 1;
+        }
+
+        // Start again from the first holder once all holders have been processed
+        if (itr == summaries.end())
+        {
+            state.cursor = 0;
+        }
+        state.last_run = now;
+        distribution_instance.set(state, get_self());
+    }
+
+    std::vector<vestingToken::allocation_claimable> vestingToken::claimable(eosio::name holder)
+    {
+        time_point now = eosio::current_time_point();
+
+        settings_table settings_table_instance(get_self(), get_self().value);
+        vesting_settings settings = settings_table_instance.get();
+
+        std::vector<allocation_claimable> result;
+        for_each_allocation(holder, [&](const vested_allocation_v2 &allocation)
+                            {
+            const vesting_category &category = get_vesting_category(allocation.vesting_category_type);
+
+            // Nothing can be withdrawn before the launch date
+            int64_t unlocked = now >= settings.launch_date ? get_unlocked(allocation, category, settings.launch_date, now) : allocation.tokens_claimed;
+
+            result.push_back({allocation.id,
+                              allocation.vesting_category_type,
+                              eosio::asset(allocation.tokens_allocated, system_resource_currency),
+                              eosio::asset(allocation.tokens_claimed, system_resource_currency),
+                              eosio::asset(unlocked - allocation.tokens_claimed, system_resource_currency)}); });
+        return result;
+    }
+
+    std::vector<eosio::asset> vestingToken::unlockcurve(eosio::name holder, std::vector<eosio::time_point> times)
+    {
+        settings_table settings_table_instance(get_self(), get_self().value);
+        vesting_settings settings = settings_table_instance.get();
+
+        std::vector<int64_t> unlocked(times.size(), 0);
+        for_each_allocation(holder, [&](const vested_allocation_v2 &allocation)
+                            {
+            const vesting_category &category = get_vesting_category(allocation.vesting_category_type);
+            for (size_t i = 0; i < times.size(); i++)
+            {
+                if (times[i] >= settings.launch_date)
+                {
+                    unlocked[i] += get_unlocked(allocation, category, settings.launch_date, times[i]);
+                }
+            } });
+
+        std::vector<eosio::asset> result;
+        result.reserve(times.size());
+        for (int64_t amount : unlocked)
+        {
+            result.push_back(eosio::asset(amount, system_resource_currency));
+        }
+        return result;
+    }
+
+    eosio::time_point vestingToken::nextunlock(eosio::name holder)
+    {
+        time_point now = eosio::current_time_point();
+
+        settings_table settings_table_instance(get_self(), get_self().value);
+        vesting_settings settings = settings_table_instance.get();
+
+        microseconds since_launch = now - settings.launch_date;
+        microseconds next_unlock = microseconds::maximum();
+        for_each_allocation(holder, [&](const vested_allocation_v2 &allocation)
+                            { next_unlock = std::min(next_unlock, get_next_unlock(get_vesting_category(allocation.vesting_category_type), since_launch)); });
+
+        if (next_unlock == microseconds::maximum())
+        {
+            return time_point(microseconds::maximum());
+        }
+        return settings.launch_date + next_unlock;
+    }
+
+    std::vector<eosio::asset> vestingToken::unlockcal(eosio::time_point start, uint16_t days)
+    {
+        eosio::check(days > 0 && days <= MAX_CALENDAR_DAYS, "Days must be between 1 and " + std::to_string(MAX_CALENDAR_DAYS));
+
+        settings_table settings_table_instance(get_self(), get_self().value);
+        vesting_settings settings = settings_table_instance.get();
+
+        category_totals totals(get_self(), get_self().value);
+        std::vector<int64_t> unlocked(days, 0);
+        for (auto itr = totals.begin(); itr != totals.end(); ++itr)
+        {
+            // All allocations in a category share the same schedule, so the category can be evaluated as one allocation
+            const vesting_category &category = get_vesting_category(itr->category);
+            int64_t vesting_start = (settings.launch_date + microseconds(category.start_delay)).time_since_epoch().count();
+
+            int64_t day_start = start.time_since_epoch().count();
+            int64_t vested_before = vested_amount(category, itr->tokens_allocated, day_start - vesting_start);
+            for (uint16_t day = 0; day < days; day++)
+            {
+                int64_t vested_after = vested_amount(category, itr->tokens_allocated, day_start + DAY_MICROSECONDS - vesting_start);
+                unlocked[day] += vested_after - vested_before;
+                vested_before = vested_after;
+                day_start += DAY_MICROSECONDS;
+            }
+        }
+
+        std::vector<eosio::asset> result;
+        result.reserve(days);
+        for (int64_t amount : unlocked)
+        {
+            result.push_back(eosio::asset(amount, system_resource_currency));
+        }
+        return result;
+    }
+
     // Migrates an allocation to a new amount and category
     void vestingToken::migratealloc(eosio::name sender, name holder, uint64_t allocation_id, eosio::asset old_amount, eosio::asset new_amount, int old_category_id, int new_category_id)
     {
@@ -168,20 +620,30 @@ namespace vestingtoken
         check_asset(new_amount);
 
         // Get the vesting allocations
-        vesting_allocations vesting_table(get_self(), holder.value);
+        migrate_allocations(holder, MAX_ALLOCATIONS);
+        vesting_allocations_v2 vesting_table(get_self(), holder.value);
         auto iter = vesting_table.find(allocation_id);
         eosio::check(iter != vesting_table.end(), "Allocation not found");
 
         // Checks to verify new allocation is valid
-        eosio::check(iter->tokens_allocated.amount == old_amount.amount, "Old amount does not match existing allocation");
+        eosio::check(iter->tokens_allocated == old_amount.amount, "Old amount does not match existing allocation");
         eosio::check(iter->vesting_category_type == old_category_id, "Old category does not match existing allocation");
-        eosio::check(iter->tokens_claimed.amount < new_amount.amount, "New amount is less than the amount already claimed");
+        eosio::check(iter->tokens_claimed < new_amount.amount, "New amount is less than the amount already claimed");
+
+        // Allocations of holders without a summary are added to the category totals when their summary is created
+        holder_summaries summaries(get_self(), get_self().value);
+        auto summary_itr = summaries.find(holder.value);
+        if (summary_itr != summaries.end())
+        {
+            add_category_total(iter->vesting_category_type, -iter->tokens_allocated, -iter->tokens_claimed);
+            add_category_total(static_cast<uint16_t>(new_category_id), new_amount.amount, iter->tokens_claimed);
+        }
 
         // Modify the table row data, and update the table
         vesting_table.modify(iter, get_self(), [&](auto &row)
                              {
-            row.tokens_allocated = new_amount;
-            row.vesting_category_type = new_category_id; });
+            row.tokens_allocated = new_amount.amount;
+            row.vesting_category_type = static_cast<uint16_t>(new_category_id); });
 
         // Notify the holder
         eosio::require_recipient(holder);
@@ -189,6 +651,15 @@ namespace vestingtoken
         // // Calculate the change in the allocation amount
         int64_t amount_change = new_amount.amount - old_amount.amount;
 
+        // Summaries that do not exist yet are created from the allocations when next needed
+        if (summary_itr != summaries.end())
+        {
+            summaries.modify(summary_itr, get_self(), [&](auto &row)
+                             {
+                row.total_allocated += eosio::asset(amount_change, system_resource_currency);
+                row.next_unlock = std::min(row.next_unlock, get_next_unlock(get_vesting_category(new_category_id), microseconds(0))); });
+        }
+
         // If new tokens were allocated, then send them to the contract
         if (amount_change > 0)
         {
@@ -209,23 +680,152 @@ namespace vestingtoken
         }
     }
 
+    void vestingToken::compact(eosio::name holder)
+    {
+        eosio::check(eosio::has_auth(holder) || eosio::has_auth(get_self()), "Missing required authority of holder or contract");
+
+        migrate_allocations(holder, MAX_ALLOCATIONS);
+        vesting_allocations_v2 vesting_table(get_self(), holder.value);
+
+        // The allocation that each category is merged into, at most one per vesting category
+        std::vector<std::pair<uint16_t, uint64_t>> merged_into;
+        uint16_t erased = 0;
+
+        for (auto iter = vesting_table.begin(); iter != vesting_table.end();)
+        {
+            auto merged = std::find_if(merged_into.begin(), merged_into.end(), [&](const auto &pair)
+                                       { return pair.first == iter->vesting_category_type; });
+
+            if (merged == merged_into.end())
+            {
+                merged_into.push_back({iter->vesting_category_type, iter->id});
+                ++iter;
+                continue;
+            }
+
+            auto target = vesting_table.find(merged->second);
+            vesting_table.modify(target, get_self(), [&](auto &row)
+                                 {
+                row.tokens_allocated += iter->tokens_allocated;
+                row.tokens_claimed += iter->tokens_claimed; });
+
+            iter = vesting_table.erase(iter);
+            erased++;
+        }
+
+        if (erased > 0)
+        {
+            holder_summaries summaries(get_self(), get_self().value);
+            auto summary_itr = summaries.find(holder.value);
+            if (summary_itr != summaries.end())
+            {
+                summaries.modify(summary_itr, get_self(), [&](auto &row)
+                                 { row.allocations -= erased; });
+            }
+        }
+    }
+
     void vestingToken::migrateacc(const name &account)
     {
         // Admin only
         require_auth(get_self());
 
-        vesting_allocations vesting_table(get_self(), account.value);
+        // Allocations in the allocationv2 table are always in the new symbol
+        migrate_allocations(account, MAX_ALLOCATIONS);
+    }
+
+    void vestingToken::migraterows(std::vector<eosio::name> holders, uint32_t max_rows)
+    {
+        // Admin only
+        require_auth(get_self());
+
+        settings_table settings_table_instance(get_self(), get_self().value);
+        vesting_settings settings = settings_table_instance.get();
+        microseconds since_launch = eosio::current_time_point() - settings.launch_date;
+        holder_summaries summaries(get_self(), get_self().value);
+
+        for (const eosio::name &holder : holders)
+        {
+            if (max_rows == 0)
+            {
+                break;
+            }
+            max_rows -= migrate_allocations(holder, max_rows);
+
+            // Create the summary so that the holder is included in distribute()
+            get_or_create_summary(summaries, holder, since_launch);
+        }
+    }
+
+    void vestingToken::regscopes(std::vector<eosio::name> holders)
+    {
+        // Admin only
+        require_auth(get_self());
+
+        migration_scopes scopes_table(get_self(), get_self().value);
+        migration_table migration_instance(get_self(), get_self().value);
+        migration_state state = migration_instance.get_or_default();
 
-        for (auto iter = vesting_table.begin(); iter != vesting_table.end(); ++iter)
+        for (const eosio::name &holder : holders)
         {
-            if (iter->tokens_allocated.symbol == SYSTEM_RESOURCE_CURRENCY_OLD)
+            if (scopes_table.find(holder.value) != scopes_table.end())
             {
-                vesting_table.modify(iter, get_self(), [&](auto &row)
-                                 {
-                    row.tokens_allocated = asset(row.tokens_allocated.amount, system_resource_currency);
-                    row.tokens_claimed = asset(row.tokens_claimed.amount, system_resource_currency);
-                });
-            }            
+                continue;
+            }
+            scopes_table.emplace(get_self(), [&](auto &row)
+                                 { row.scope = holder; });
+
+            // Make sure the next migrate() call visits the new holder
+            if (state.complete)
+            {
+                state.cursor = holder.value;
+                state.complete = false;
+            }
+            else if (holder.value < state.cursor)
+            {
+                state.cursor = holder.value;
+            }
+        }
+
+        migration_instance.set(state, get_self());
+    }
+
+    bool vestingToken::migrate(uint32_t batch_size)
+    {
+        // Admin only
+        require_auth(get_self());
+        eosio::check(batch_size > 0 && batch_size <= MAX_MIGRATE_BATCH_SIZE, "Batch size must be between 1 and " + std::to_string(MAX_MIGRATE_BATCH_SIZE));
+
+        migration_table migration_instance(get_self(), get_self().value);
+        migration_state state = migration_instance.get_or_default();
+        if (state.complete)
+        {
+            return true;
         }
+
+        settings_table settings_table_instance(get_self(), get_self().value);
+        vesting_settings settings = settings_table_instance.get();
+        microseconds since_launch = eosio::current_time_point() - settings.launch_date;
+        holder_summaries summaries(get_self(), get_self().value);
+        migration_scopes scopes_table(get_self(), get_self().value);
+
+        scope_migration::migration_result result = scope_migration::migrate(scopes_table, state.cursor, batch_size, [&](const eosio::name &holder, uint32_t budget)
+                                                                            {
+            uint32_t migrated = migrate_allocations(holder, budget);
+            // A holder that used the whole budget may have allocations left, it is resumed by the next call
+            bool done = migrated < budget;
+            if (done)
+            {
+                // Create the summary so that the holder is included in distribute()
+                get_or_create_summary(summaries, holder, since_launch);
+            }
+            return scope_migration::scope_result{migrated, done}; });
+
+        state.cursor = result.cursor;
+        state.migrated += result.rows;
+        state.complete = result.complete;
+        migration_instance.set(state, get_self());
+
+        return state.complete;
     }
-}
\ No newline at end of file
+}